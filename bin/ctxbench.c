@@ -0,0 +1,84 @@
+/*
+ * ctxbench — context-switch latency benchmark.
+ *
+ * Times N_ROUNDS yield() calls with the TSC in three settings:
+ *
+ *   yield alone:     <n> cycles   nothing else runnable: syscall, no switch
+ *   process switch:  <n> cycles   ping-pong with a copy of itself
+ *                                 ("ctxbench spin"): CR3 is reloaded
+ *   thread switch:   <n> cycles   ping-pong with a thread of this process:
+ *                                 same page directory, no CR3 load
+ *
+ * With a partner each of our yields is two switches (there and back), so
+ * the switch rows are halved.  Kernel mappings are global, so neither kind
+ * of switch flushes them.  Prints "ctxbench: OK".
+ */
+
+#define TEST_NAME "ctxbench"
+#include "os.h"
+
+#define N_ROUNDS 2000
+
+static inline unsigned int rdtsc_lo(void)
+{
+    unsigned int lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void print_num(unsigned int n, int width)
+{
+    char buf[12];
+    int i = 0;
+    if (n == 0) { buf[i++] = '0'; }
+    else { while (n) { buf[i++] = (char)('0' + n % 10); n /= 10; } }
+    for (int sp = i; sp < width; sp++) write(STDOUT, " ", 1);
+    for (int d = i - 1; d >= 0; d--)
+        write(STDOUT, &buf[d], 1);
+}
+
+static void row(const char *label, unsigned int cycles)
+{
+    print(label);
+    print_num(cycles, 7);
+    print(" cycles\n");
+}
+
+/* Average cycles per yield() over N_ROUNDS */
+static unsigned int time_yields(void)
+{
+    unsigned int t0 = rdtsc_lo();
+    for (int i = 0; i < N_ROUNDS; i++) yield();
+    return (rdtsc_lo() - t0) / N_ROUNDS;
+}
+
+/* Partner: yield back as often as we do */
+static int spin(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < N_ROUNDS; i++) yield();
+    return 0;
+}
+
+void main(void)
+{
+    const char *args = get_args();
+    if (args[0] == 's') exit(spin(0));   /* "spin" */
+
+    row("yield alone:    ", time_yields());
+
+    int pid = exec_bg("ctxbench", "spin");
+    if (pid < 0) fail("exec_bg");
+    yield();                             /* let it start */
+    row("process switch: ", time_yields() / 2);
+    int status = -1;
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("spin child status");
+
+    int tid = thread_create(spin, 0);
+    if (tid < 0) fail("thread_create");
+    yield();
+    row("thread switch:  ", time_yields() / 2);
+    if (thread_join(tid, &status) != tid || status != 0) fail("spin thread status");
+
+    pass();
+}
@@ -6,6 +6,7 @@
  *          total       used       free
  * Phys:   130048     1200    128848
  * Virt:     8192      568      7624   (2 procs)
+ * Swap:      512        0       512
  */
 
 #include "os.h"
@@ -58,5 +59,13 @@ void main(void)
     print_num((unsigned int)m.n_procs, 1);
     print(m.n_procs == 1 ? " proc)\n" : " procs)\n");
 
+    print("Swap:  ");
+    print_num(m.swap_total_kb, 8);
+    print(" kB");
+    print_num(m.swap_used_kb,  8);
+    print(" kB");
+    print_num(m.swap_total_kb - m.swap_used_kb, 8);
+    print(" kB\n");
+
     exit(0);
 }
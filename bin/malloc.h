@@ -2,7 +2,7 @@
  * malloc.h — simple first-fit free-list heap allocator for YOLO-OS user programs.
  *
  * Uses the SYS_SBRK syscall to map pages on demand from the heap region
- * (HEAP_BASE = 0x440000 up to 0x7F8000, ~3.7 MB).
+ * (HEAP_BASE = 0x440000 up to 0x700000, ~2.7 MB; the mmap area follows).
  *
  * Each allocation is preceded by a 12-byte struct _blk header.
  * Include after os.h:
@@ -0,0 +1,145 @@
+/*
+ * msgbench — message-passing ping-pong benchmark.
+ *
+ * Starts a copy of itself as a server ("msgbench server") that answers
+ * every message with the first word incremented, times N_ROUNDS
+ * msg_send() round trips with the TSC, then does the same ping-pong over
+ * a pair of pipes for comparison ("msgbench pipe" echoes stdin to stdout):
+ *
+ *   msg  round trip: <n> cycles
+ *   pipe round trip: <n> cycles
+ *
+ * Every reply is checked, as are the error cases: sending to itself or to
+ * a missing pid, replying to a process that is not waiting, and a send
+ * whose receiver exits without replying.  Prints "msgbench: OK".
+ */
+
+#define TEST_NAME "msgbench"
+#include "os.h"
+
+#define N_ROUNDS 2000
+#define MSG_QUIT 0xFFFFFFFFu   /* server exits without replying */
+
+static inline unsigned int rdtsc_lo(void)
+{
+    unsigned int lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void print_num(unsigned int n, int width)
+{
+    char buf[12];
+    int i = 0;
+    if (n == 0) { buf[i++] = '0'; }
+    else { while (n) { buf[i++] = (char)('0' + n % 10); n /= 10; } }
+    for (int sp = i; sp < width; sp++) write(STDOUT, " ", 1);
+    for (int d = i - 1; d >= 0; d--)
+        write(STDOUT, &buf[d], 1);
+}
+
+/* Child: answer messages until MSG_QUIT */
+static void server(void)
+{
+    struct msg m;
+    for (;;) {
+        int pid = msg_receive(&m);
+        if (pid <= 0) exit(1);
+        if (m.w[0] == MSG_QUIT) exit(0);
+        m.w[0]++;
+        if (msg_reply(pid, &m) != 0) exit(2);
+    }
+}
+
+/* Child: echo stdin to stdout until EOF */
+static void echo(void)
+{
+    char buf[sizeof(struct msg)];
+    int n;
+    while ((n = read(STDIN, buf, sizeof(buf))) > 0)
+        if (write(STDOUT, buf, n) != n) exit(1);
+    exit(0);
+}
+
+static unsigned int msg_pingpong(int pid)
+{
+    struct msg req, rep;
+    for (int i = 0; i < MSG_WORDS; i++) req.w[i] = 0x1000u * (unsigned int)i;
+
+    unsigned int t0 = rdtsc_lo();
+    for (unsigned int n = 0; n < N_ROUNDS; n++) {
+        req.w[0] = n;
+        if (msg_send(pid, &req, &rep) != 0) fail("send");
+        if (rep.w[0] != n + 1)              fail("reply");
+    }
+    unsigned int cycles = (rdtsc_lo() - t0) / N_ROUNDS;
+
+    for (int i = 1; i < MSG_WORDS; i++)
+        if (rep.w[i] != req.w[i]) fail("message body");
+    return cycles;
+}
+
+static unsigned int pipe_pingpong(void)
+{
+    int to[2], from[2];
+    if (pipe(to) < 0 || pipe(from) < 0) fail("pipe");
+    dup2(to[0], STDIN);
+    dup2(from[1], STDOUT);
+    int pid = exec_bg("msgbench", "pipe");
+    close(STDIN);                      /* back to the console */
+    close(STDOUT);
+    close(to[0]);
+    close(from[1]);
+    if (pid < 0) fail("exec_bg pipe");
+
+    struct msg req, rep;
+    for (int i = 0; i < MSG_WORDS; i++) req.w[i] = 0;
+    unsigned int t0 = rdtsc_lo();
+    for (unsigned int n = 0; n < N_ROUNDS; n++) {
+        req.w[0] = n;
+        if (write(to[1], (const char *)&req, sizeof(req)) != sizeof(req)) fail("pipe write");
+        if (read(from[0], (char *)&rep, sizeof(rep)) != sizeof(rep))      fail("pipe read");
+        if (rep.w[0] != n) fail("pipe data");
+    }
+    unsigned int cycles = (rdtsc_lo() - t0) / N_ROUNDS;
+
+    close(to[1]);                      /* EOF: the echo child exits */
+    close(from[0]);
+    int status = -1;
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("pipe child status");
+    return cycles;
+}
+
+void main(void)
+{
+    const char *args = get_args();
+    if (args[0] == 's') server();      /* "server" */
+    if (args[0] == 'p') echo();        /* "pipe"   */
+
+    struct msg m;
+    for (int i = 0; i < MSG_WORDS; i++) m.w[i] = 0;
+    if (msg_send(getpid(), &m, &m) != -1) fail("send to self");
+    if (msg_send(99999, &m, &m) != -1)    fail("send to missing pid");
+    if (msg_reply(getpid(), &m) != -1)    fail("reply without a request");
+
+    int pid = exec_bg("msgbench", "server");
+    if (pid < 0) fail("exec_bg server");
+
+    unsigned int c = msg_pingpong(pid);
+    print("msg  round trip: ");
+    print_num(c, 7);
+    print(" cycles\n");
+
+    m.w[0] = MSG_QUIT;
+    if (msg_send(pid, &m, &m) != -1) fail("send to exiting server");
+    int status = -1;
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("server status");
+    if (msg_send(pid, &m, &m) != -1) fail("send to reaped server");
+
+    c = pipe_pingpong();
+    print("pipe round trip: ");
+    print_num(c, 7);
+    print(" cycles\n");
+
+    pass();
+}
@@ -2,6 +2,8 @@
  * os.h - YOLO-OS interface for programs
  *
  * Syscall ABI: int 0x80, EAX=number, EBX/ECX/EDX=args, return value in EAX.
+ * Build with -DFAST_SYSCALL (make FAST_SYSCALL=1) to enter the kernel via
+ * SYSENTER instead; arguments and return value are the same.
  * All functions are static inline — include this header, no linking needed.
  */
 
@@ -22,6 +24,25 @@
 /* open() flags */
 #define O_RDONLY 0
 #define O_WRONLY 1
+#define O_RDWR   2
+#define O_CREAT  0x40    /* create the file if it does not exist    */
+#define O_TRUNC  0x200   /* discard existing contents (needs write) */
+#define O_APPEND 0x400   /* every write goes to the current end     */
+
+/* lseek() whence */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/* mmap() flags: PROT_READ/PROT_WRITE plus MAP_SHARED or MAP_PRIVATE */
+#define PROT_READ   0x01
+#define PROT_WRITE  0x02
+#define MAP_SHARED  0x10   /* writes reach the file (on munmap/exit)  */
+#define MAP_PRIVATE 0x20   /* private copy, never written back        */
+#define MAP_FAILED  ((void *)-1)
+
+/* shm_attach() flags */
+#define SHM_CREATE  0x01   /* create the segment if the key is new    */
 
 /* Syscall numbers — screen control */
 #define SYS_GETCHAR          5
@@ -41,9 +62,58 @@
 #define SYS_MEMINFO 17
 #define SYS_SBRK    18
 #define SYS_SLEEP   19
+#define SYS_YIELD   20
+#define SYS_WAITPID 21
+#define SYS_GETPID  22
+#define SYS_SYSSTAT 23
+#define SYS_LSEEK   24
+#define SYS_IOSTAT  25
+#define SYS_MMAP    26
+#define SYS_MUNMAP  27
+#define SYS_PIPE    28
+#define SYS_DUP2    29
+#define SYS_SHMAT   30
+#define SYS_SHMDT   31
+#define SYS_SEND    32
+#define SYS_RECEIVE 33
+#define SYS_REPLY   34
+#define SYS_FORK    35
+#define SYS_THREAD  36
+#define SYS_JOIN    37
+#define SYS_FUTEX_WAIT 38
+#define SYS_FUTEX_WAKE 39
+#define SYS_PAGEOUT 40
+#define SYS_SETLIMIT 41
+#define SYS_PROCINFO 42
+#define NR_SYSCALLS 43
+
+/* waitpid() options */
+#define WNOHANG     1   /* return 0 instead of blocking if no child has exited */
+
+/* setlimit() limits */
+#define LIMIT_RSS   0   /* resident user memory: beyond it, own pages go to swap */
+#define LIMIT_HEAP  1   /* heap size: sbrk() fails beyond it                   */
 
 struct direntry { char name[13]; unsigned int size; int is_dir; };
 
+/* iostat() result: disk read and readahead counters (in sectors) */
+struct iostat {
+    unsigned int read_cmds;       /* ATA READ SECTORS commands          */
+    unsigned int read_sectors;    /* sectors transferred by them        */
+    unsigned int ra_prefetched;   /* pages read ahead of demand         */
+    unsigned int ra_hits;         /* prefetched pages later used        */
+    unsigned int ra_waste;        /* prefetched pages dropped unused    */
+    unsigned int wb_pages;        /* dirty pages written back           */
+    unsigned int wb_flushes;      /* file write-backs                   */
+    unsigned int rd_direct;       /* pages read straight into user buffers */
+};
+
+/* sysstat() entry, indexed by syscall number */
+struct sysstat_entry {
+    unsigned int       count;    /* invocations                           */
+    unsigned long long cycles;   /* total TSC cycles spent in the handler */
+};
+
 struct meminfo {
     unsigned int phys_total_kb;
     unsigned int phys_used_kb;
@@ -52,6 +122,29 @@ struct meminfo {
     unsigned int virt_used_kb;
     unsigned int virt_free_kb;
     int          n_procs;
+    unsigned int swap_total_kb;   /* 0 = no swap file */
+    unsigned int swap_used_kb;
+};
+
+/* procinfo() entry: one process, its threads counted in it */
+struct procinfo {
+    int          pid;
+    int          parent_pid;
+    int          threads;         /* besides the main one                    */
+    unsigned int rss_kb;          /* resident user pages × 4                 */
+    unsigned int swap_kb;         /* pages in swap × 4                       */
+    unsigned int heap_kb;         /* sbrk() total                            */
+    unsigned int rss_limit_kb;    /* 0 = no limit                            */
+    unsigned int heap_limit_kb;   /* 0 = no limit                            */
+    char         state;           /* R run, S sleep, W wait for exec, Z zombie */
+    char         name[16];
+};
+
+/* msg_send / msg_receive / msg_reply: one fixed-size message */
+#define MSG_WORDS 8
+
+struct msg {
+    unsigned int w[MSG_WORDS];
 };
 
 /* Arrow key codes returned by get_char() */
@@ -61,20 +154,94 @@ struct meminfo {
 #define KEY_RIGHT 0x83
 
 /* Program argument string — written by kernel before exec_run() */
-#define ARGS_BASE  0x7FC000
+#define ARGS_BASE  0x7FF000   /* the page above the stack */
 #define HEAP_BASE  0x440000   /* first heap virtual address (right after binary) */
 static inline const char *get_args(void) { return (const char *)ARGS_BASE; }
 
-/* Memory utility */
-static inline void *memset(void *s, int c, unsigned int n)
+/* Memory utilities: memcpy / memset / memmove (rep movs/stos), shared with the kernel */
+#include "../kernel/memops.h"
+
+/* CPUID.1:EDX bit 26 (SSE2) — the kernel enables SSE for user programs if present */
+static inline int cpu_has_sse2(void)
 {
-    unsigned char *p = (unsigned char *)s;
-    while (n--) *p++ = (unsigned char)c;
-    return s;
+    static int has = -1;
+    if (has < 0) {
+        unsigned int eax = 1, ebx, ecx, edx;
+        __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+        has = (edx >> 26) & 1;
+    }
+    return has;
 }
 
-/* Raw syscall — up to 3 arguments */
-static inline int syscall(int num, int a, int b, int c)
+/*
+ * SSE2 variants for large buffers: 64 bytes per iteration through
+ * XMM0-XMM3 (unaligned loads, aligned stores once dst is 16-byte aligned).
+ * Programs are built without -msse, so the compiler never keeps anything
+ * in XMM registers and the asm needs no clobbers for them (and may not
+ * name them).
+ * Using them makes the process an FPU owner, so its XMM state is saved on
+ * the next switch; below MEM_SSE2_MIN bytes, or without SSE2, they fall
+ * back to the rep versions.
+ */
+#define MEM_SSE2_MIN 512
+
+static inline void *memcpy_sse2(void *dst, const void *src, unsigned int n)
+{
+    if (n < MEM_SSE2_MIN || !cpu_has_sse2()) return memcpy(dst, src, n);
+    unsigned char       *d = (unsigned char *)dst;
+    const unsigned char *s = (const unsigned char *)src;
+    unsigned int head = (0u - (unsigned int)d) & 15;
+    memcpy(d, s, head);
+    d += head; s += head; n -= head;
+    unsigned int blocks = n >> 6;
+    __asm__ volatile (
+        "1:\n"
+        "movdqu   (%1), %%xmm0\n"
+        "movdqu 16(%1), %%xmm1\n"
+        "movdqu 32(%1), %%xmm2\n"
+        "movdqu 48(%1), %%xmm3\n"
+        "movdqa %%xmm0,   (%0)\n"
+        "movdqa %%xmm1, 16(%0)\n"
+        "movdqa %%xmm2, 32(%0)\n"
+        "movdqa %%xmm3, 48(%0)\n"
+        "add    $64, %0\n"
+        "add    $64, %1\n"
+        "dec    %2\n"
+        "jnz    1b"
+        : "+r"(d), "+r"(s), "+r"(blocks)
+        :: "memory", "cc");
+    memcpy(d, s, n & 63);
+    return dst;
+}
+
+static inline void *memset_sse2(void *dst, int c, unsigned int n)
+{
+    if (n < MEM_SSE2_MIN || !cpu_has_sse2()) return memset(dst, c, n);
+    unsigned char *d = (unsigned char *)dst;
+    unsigned int head = (0u - (unsigned int)d) & 15;
+    memset(d, c, head);
+    d += head; n -= head;
+    unsigned int blocks = n >> 6;
+    __asm__ volatile (
+        "movd   %2, %%xmm0\n"
+        "pshufd $0, %%xmm0, %%xmm0\n"
+        "1:\n"
+        "movdqa %%xmm0,   (%0)\n"
+        "movdqa %%xmm0, 16(%0)\n"
+        "movdqa %%xmm0, 32(%0)\n"
+        "movdqa %%xmm0, 48(%0)\n"
+        "add    $64, %0\n"
+        "dec    %1\n"
+        "jnz    1b"
+        : "+r"(d), "+r"(blocks)
+        : "r"((unsigned char)c * 0x01010101u)
+        : "memory", "cc");
+    memset(d, c, n & 63);
+    return dst;
+}
+
+/* Raw syscall via int 0x80 — up to 3 arguments */
+static inline int syscall_int80(int num, int a, int b, int c)
 {
     int ret;
     __asm__ volatile (
@@ -86,6 +253,36 @@ static inline int syscall(int num, int a, int b, int c)
     return ret;
 }
 
+/* Raw syscall via SYSENTER — the kernel returns with SYSEXIT, which takes
+ * the user ESP from EBP and the return EIP from ESI on the way in and
+ * hands them back in ECX/EDX (so those two are clobbered). */
+static inline int syscall_sysenter(int num, int a, int b, int c)
+{
+    int ret;
+    __asm__ volatile (
+        "push %%ebp\n"
+        "mov  %%esp, %%ebp\n"
+        "mov  $1f, %%esi\n"
+        "sysenter\n"
+        "1:\n"
+        "pop  %%ebp\n"
+        : "=a"(ret), "+c"(b), "+d"(c)
+        : "0"(num), "b"(a)
+        : "esi", "memory", "cc"
+    );
+    return ret;
+}
+
+/* Raw syscall — up to 3 arguments; entry path chosen at build time */
+static inline int syscall(int num, int a, int b, int c)
+{
+#ifdef FAST_SYSCALL
+    return syscall_sysenter(num, a, b, c);
+#else
+    return syscall_int80(num, a, b, c);
+#endif
+}
+
 /* Extend heap by n bytes; returns old break address, or (void*)-1 on failure */
 static inline void *sbrk(unsigned int n)
 {
@@ -117,6 +314,11 @@ static inline int close(int fd)
     return syscall(SYS_CLOSE, fd, 0, 0);
 }
 
+static inline int lseek(int fd, int off, int whence)
+{
+    return syscall(SYS_LSEEK, fd, off, whence);
+}
+
 /* Utility: string length */
 static inline int strlen(const char *s)
 {
@@ -161,6 +363,10 @@ static inline int exec(const char *name, const char *args)
 /* Execute a program in the background; returns child PID or -1 */
 static inline int exec_bg(const char *name, const char *args)
     { return syscall(SYS_EXEC, (int)name, (int)args, EXEC_BG); }
+/* Duplicate this process (copy-on-write).  Returns the child's PID in the
+ * parent, 0 in the child, -1 on failure; reap the child with waitpid() */
+static inline int fork(void)
+    { return syscall(SYS_FORK, 0, 0, 0); }
 /* Change current working directory */
 static inline int chdir(const char *name)
     { return syscall(SYS_CHDIR, (int)name, 0, 0); }
@@ -171,9 +377,160 @@ static inline void kernel_panic(const char *msg)
     { syscall(SYS_PANIC, (int)msg, 0, 0); }
 static inline int meminfo(struct meminfo *info)
     { return syscall(SYS_MEMINFO, (int)info, 0, 0); }
+/* Write the binary/heap/stack pages of [addr, addr + len) to swap now;
+ * the next access reads them back.  Returns pages written, or -1 */
+static inline int pageout(const void *addr, unsigned int len)
+    { return syscall(SYS_PAGEOUT, (int)addr, (int)len, 0); }
+/* Set a LIMIT_* of this process and the ones it starts to kb (0 = none);
+ * kb < 0 only reads it.  Returns the previous limit in kB, or -1 */
+static inline int setlimit(int which, int kb)
+    { return syscall(SYS_SETLIMIT, which, kb, 0); }
+/* Fill buf with up to max processes; returns how many */
+static inline int procinfo(struct procinfo *buf, int max)
+    { return syscall(SYS_PROCINFO, (int)buf, max, 0); }
 /* Sleep for at least ms milliseconds (granularity: 10 ms at 100 Hz) */
 static inline int sleep(unsigned int ms)
     { return syscall(SYS_SLEEP, (int)ms, 0, 0); }
+/* Give up the CPU to the next runnable process */
+static inline int yield(void)
+    { return syscall(SYS_YIELD, 0, 0, 0); }
+/* Reap a finished background child (pid -1 = any); returns its PID,
+ * 0 if options has WNOHANG and none has exited yet, -1 if no such child */
+static inline int waitpid(int pid, int *status, int options)
+    { return syscall(SYS_WAITPID, pid, (int)status, options); }
+/* PID of the calling process (also the cheapest possible syscall) */
+static inline int getpid(void)
+    { return syscall(SYS_GETPID, 0, 0, 0); }
+/* Copy per-syscall statistics (up to max entries); returns entries copied */
+static inline int sysstat(struct sysstat_entry *buf, int max)
+    { return syscall(SYS_SYSSTAT, (int)buf, max, 0); }
+
+static inline int iostat(struct iostat *buf)
+    { return syscall(SYS_IOSTAT, (int)buf, 0, 0); }
+/* Map the first len bytes of fd (0 = whole file); pages load on first touch */
+static inline void *mmap(int fd, unsigned int len, int flags)
+    { return (void *)syscall(SYS_MMAP, fd, (int)len, flags); }
+/* Remove the mapping that starts at addr */
+static inline int munmap(void *addr)
+    { return syscall(SYS_MUNMAP, (int)addr, 0, 0); }
+/* New pipe: fds[0] reads what fds[1] writes; returns 0 or -1 */
+static inline int pipe(int fds[2])
+    { return syscall(SYS_PIPE, (int)fds, 0, 0); }
+/* Make newfd (e.g. STDIN/STDOUT) refer to oldfd's file; close(newfd) undoes
+ * it for 0/1 (back to the console).  Returns newfd or -1 */
+static inline int dup2(int oldfd, int newfd)
+    { return syscall(SYS_DUP2, oldfd, newfd, 0); }
+/* Map shared memory segment key (non-zero), creating a zeroed one of size
+ * bytes with SHM_CREATE; every process attaching key sees the same pages */
+static inline void *shm_attach(unsigned int key, unsigned int size, int flags)
+    { return (void *)syscall(SYS_SHMAT, (int)key, (int)size, flags); }
+/* Unmap the segment at addr; the last detach frees it */
+static inline int shm_detach(void *addr)
+    { return syscall(SYS_SHMDT, (int)addr, 0, 0); }
+/* Send req to process pid and block until it replies into *reply.
+ * Returns 0, or -1 if there is no such process or it exits first */
+static inline int msg_send(int pid, const struct msg *req, struct msg *reply)
+    { return syscall(SYS_SEND, pid, (int)req, (int)reply); }
+/* Block until a message arrives; returns the sender's pid */
+static inline int msg_receive(struct msg *m)
+    { return syscall(SYS_RECEIVE, (int)m, 0, 0); }
+/* Answer the message received from pid; returns 0 or -1 */
+static inline int msg_reply(int pid, const struct msg *m)
+    { return syscall(SYS_REPLY, pid, (int)m, 0); }
+
+/* Threads: the kernel starts every thread here, on its own stack; returning
+ * from fn ends the thread with fn's return value as its status */
+static inline void thread_start(int (*fn)(void *), void *arg)
+    { exit(fn(arg)); }
+/* Run fn(arg) in a new thread of this process (up to 8 at a time, 12 KB
+ * of stack each); returns its thread id or -1 */
+static inline int thread_create(int (*fn)(void *), void *arg)
+    { return syscall(SYS_THREAD, (int)fn, (int)arg, (int)thread_start); }
+/* Block until thread tid exits; stores its status, returns tid or -1 */
+static inline int thread_join(int tid, int *status)
+    { return syscall(SYS_JOIN, tid, (int)status, 0); }
+/* End the calling thread; in the main thread, exit() ends them all */
+static inline void thread_exit(int status) { exit(status); }
+/* Sleep until futex_wake(addr), unless *addr != val (then -1 at once) */
+static inline int futex_wait(volatile int *addr, int val)
+    { return syscall(SYS_FUTEX_WAIT, (int)addr, val, 0); }
+/* Wake up to n threads sleeping on addr; returns how many were woken */
+static inline int futex_wake(volatile int *addr, int n)
+    { return syscall(SYS_FUTEX_WAKE, (int)addr, n, 0); }
+
+/* Atomically: if *p == old, *p = new.  Returns the previous *p */
+static inline int atomic_cmpxchg(volatile int *p, int old, int new)
+{
+    int prev;
+    __asm__ volatile ("lock cmpxchgl %2, %1"
+                      : "=a"(prev), "+m"(*p) : "r"(new), "0"(old) : "memory");
+    return prev;
+}
+
+/* Atomically: *p = v.  Returns the previous *p */
+static inline int atomic_xchg(volatile int *p, int v)
+{
+    __asm__ volatile ("xchgl %0, %1" : "+r"(v), "+m"(*p) : : "memory");
+    return v;
+}
+
+/* Mutex on a futex: 0 = free, 1 = locked, 2 = locked and maybe contended.
+ * Uncontended lock and unlock stay in user space. */
+struct mutex { volatile int state; };
+#define MUTEX_INIT { 0 }
+
+static inline void mutex_lock(struct mutex *m)
+{
+    int c = atomic_cmpxchg(&m->state, 0, 1);
+    if (c == 0) return;
+    if (c != 2) c = atomic_xchg(&m->state, 2);
+    while (c != 0) {
+        futex_wait(&m->state, 2);
+        c = atomic_xchg(&m->state, 2);
+    }
+}
+
+static inline void mutex_unlock(struct mutex *m)
+{
+    if (atomic_xchg(&m->state, 0) == 2) futex_wake(&m->state, 1);
+}
+
+#ifdef TEST_NAME
+/*
+ * Test fixture for bin/t_*.c: #define TEST_NAME "name" before including
+ * this header, and TEST_FILE if the test creates a file to remove on
+ * failure.  Take a meminfo() snapshot once kernel tables are warm, run
+ * the test, then check_no_leak() and pass().
+ */
+
+/* Print "name: FAIL msg", remove TEST_FILE and exit(1) */
+static inline void fail(const char *msg)
+{
+    print(TEST_NAME ": FAIL ");
+    print(msg);
+    print("\n");
+#ifdef TEST_FILE
+    unlink(TEST_FILE);
+#endif
+    exit(1);
+}
+
+/* fail() unless used frames and swap slots are back to the *before snapshot */
+static inline void check_no_leak(const struct meminfo *before)
+{
+    struct meminfo now;
+    meminfo(&now);
+    if (now.phys_used_kb != before->phys_used_kb) fail("frames leaked");
+    if (now.swap_used_kb != before->swap_used_kb) fail("swap slots leaked");
+}
+
+/* Print "name: OK" and exit(0) */
+static inline void pass(void)
+{
+    print(TEST_NAME ": OK\n");
+    exit(0);
+}
+#endif /* TEST_NAME */
 
 /* Direct hardware port I/O (ring 0 only) */
 static inline void outb(unsigned short port, unsigned char val)
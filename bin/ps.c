@@ -0,0 +1,66 @@
+/*
+ * ps.c - list processes with their memory use
+ *
+ * Output (memory in kB, "-" = no limit):
+ *
+ *   PID  PPID S THR   RSS  SWAP  HEAP  RLIM  HLIM NAME
+ *     1     0 W   0   264     0     0     -     - sh
+ *     2     1 R   0   264     0     0     -     - ps
+ *
+ * S is R (running or ready), S (sleeping or blocked), W (waiting for a
+ * program it exec'd) or Z (exited, not yet reaped).  RSS counts every
+ * mapped user page, shared ones included; THR the threads besides the
+ * main one.
+ */
+
+#include "os.h"
+
+#define MAX_PROCS 32
+
+static struct procinfo procs[MAX_PROCS];
+
+/* Write a right-justified decimal number in a field of `width` chars. */
+static void print_num(unsigned int n, int width)
+{
+    char buf[12];
+    int i = 0;
+    if (n == 0) { buf[i++] = '0'; }
+    else { while (n) { buf[i++] = (char)('0' + n % 10); n /= 10; } }
+    for (int sp = i; sp < width; sp++) write(STDOUT, " ", 1);
+    for (int d = i - 1; d >= 0; d--)
+        write(STDOUT, &buf[d], 1);
+}
+
+static void print_limit(unsigned int kb)
+{
+    if (kb) print_num(kb, 6);
+    else    print("     -");
+}
+
+void main(void)
+{
+    int n = procinfo(procs, MAX_PROCS);
+    if (n < 0) {
+        print("ps: procinfo failed\n");
+        exit(1);
+    }
+
+    print("  PID  PPID S THR   RSS  SWAP  HEAP  RLIM  HLIM NAME\n");
+    for (int i = 0; i < n; i++) {
+        struct procinfo *p = &procs[i];
+        print_num((unsigned int)p->pid, 5);
+        print_num((unsigned int)p->parent_pid, 6);
+        write(STDOUT, " ", 1);
+        write(STDOUT, &p->state, 1);
+        print_num((unsigned int)p->threads, 4);
+        print_num(p->rss_kb, 6);
+        print_num(p->swap_kb, 6);
+        print_num(p->heap_kb, 6);
+        print_limit(p->rss_limit_kb);
+        print_limit(p->heap_limit_kb);
+        print(" ");
+        print(p->name);
+        print("\n");
+    }
+    exit(0);
+}
@@ -0,0 +1,73 @@
+/*
+ * scbench — null-syscall round-trip microbenchmark.
+ *
+ * Times N calls of the null syscall (getpid) through int 0x80 and through
+ * SYSENTER/SYSEXIT, using the TSC, and prints the average cycles per round
+ * trip for each path:
+ *
+ *   int 0x80:   <n> cycles/call
+ *   sysenter:   <n> cycles/call
+ */
+
+#include "os.h"
+
+#define N_CALLS 20000
+#define N_RUNS  3        /* best of N_RUNS, to filter out timer interrupts */
+
+static inline unsigned int rdtsc_lo(void)
+{
+    unsigned int lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void print_num(unsigned int n, int width)
+{
+    char buf[12];
+    int i = 0;
+    if (n == 0) { buf[i++] = '0'; }
+    else { while (n) { buf[i++] = (char)('0' + n % 10); n /= 10; } }
+    for (int sp = i; sp < width; sp++) write(STDOUT, " ", 1);
+    for (int d = i - 1; d >= 0; d--)
+        write(STDOUT, &buf[d], 1);
+}
+
+/* CPUID.1:EDX bit 11 (SEP) — cpuid is allowed in ring 3 */
+static int have_sysenter(void)
+{
+    unsigned int eax = 1, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 11) & 1;
+}
+
+/* Cycles per call, best of N_RUNS (32-bit TSC delta is plenty for N_CALLS) */
+static unsigned int bench(int use_sysenter)
+{
+    unsigned int best = 0xFFFFFFFFu;
+    for (int run = 0; run < N_RUNS; run++) {
+        unsigned int t0 = rdtsc_lo();
+        if (use_sysenter)
+            for (int i = 0; i < N_CALLS; i++) syscall_sysenter(SYS_GETPID, 0, 0, 0);
+        else
+            for (int i = 0; i < N_CALLS; i++) syscall_int80(SYS_GETPID, 0, 0, 0);
+        unsigned int per_call = (rdtsc_lo() - t0) / N_CALLS;
+        if (per_call < best) best = per_call;
+    }
+    return best;
+}
+
+void main(void)
+{
+    print("int 0x80: ");
+    print_num(bench(0), 6);
+    print(" cycles/call\n");
+
+    print("sysenter: ");
+    if (!have_sysenter()) {
+        print("not supported by this CPU\n");
+        exit(0);
+    }
+    print_num(bench(1), 6);
+    print(" cycles/call\n");
+    exit(0);
+}
@@ -2,8 +2,9 @@
  * sh.c - YOLO-OS user-space shell
  *
  * Runs as the first user process (loaded from /bin/sh by the kernel).
- * Supports: inline editing with arrow keys, cd, __exit, and running
- * any program found in /bin by name.
+ * Supports: inline editing with arrow keys, cd, ulimit, __exit, and
+ * running any program found in /bin by name, in the background with a
+ * trailing '&' or as a pipeline "a | b | c".
  */
 
 #include "os.h"
@@ -17,6 +18,7 @@
 
 #define CMD_MAX   79
 #define CWD_MAX   128
+#define PIPE_STAGES 4
 
 /* ── small helpers ────────────────────────────────────────────────────── */
 
@@ -125,6 +127,109 @@ static void update_cwd(const char *name)
     cwd_path[len] = '\0';
 }
 
+/* ── running programs ───────────────────────────────────────────────── */
+
+/* Split "prog [args]" in place: prog gets the name, the args are returned. */
+static const char *parse_cmd(char *cmd, char prog[14])
+{
+    while (*cmd == ' ') cmd++;
+    int pi = 0;
+    while (cmd[pi] && cmd[pi] != ' ' && pi < 13) { prog[pi] = cmd[pi]; pi++; }
+    prog[pi] = '\0';
+    const char *args = &cmd[pi];
+    while (*args == ' ') args++;
+    return args;
+}
+
+/*
+ * Run "a | b | ...": every stage but the last starts in the background
+ * with stdout on a fresh pipe, whose read end becomes the next stage's
+ * stdin; the last runs in the foreground.  A child inherits the shell's
+ * stdin/stdout, so the shell points its own 0/1 at the pipe ends just for
+ * the exec, and close() puts them back on the console.
+ */
+static void run_pipeline(char *cmd)
+{
+    char *stage[PIPE_STAGES];
+    int   n = 0;
+    stage[n++] = cmd;
+    for (char *c = cmd; *c; c++) {
+        if (*c != '|') continue;
+        if (n == PIPE_STAGES) { sh_print("pipeline: too many stages\n"); return; }
+        *c = '\0';
+        stage[n++] = c + 1;
+    }
+
+    int pids[PIPE_STAGES];
+    for (int i = 0; i < n; i++) pids[i] = -1;
+    int in = -1;          /* read end feeding the next stage; -1 = console */
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        char prog[14];
+        const char *args = parse_cmd(stage[i], prog);
+        int last = (i == n - 1);
+        int fds[2];
+        if (!last && pipe(fds) < 0) { failed = 1; break; }
+
+        if (in >= 0)  { dup2(in, STDIN); close(in); }
+        if (!last)    { dup2(fds[1], STDOUT); close(fds[1]); }
+        pids[i] = last ? exec(prog, args) : exec_bg(prog, args);
+        close(STDIN);
+        close(STDOUT);
+        if (pids[i] < 0) failed = 1;
+        in = last ? -1 : fds[0];
+    }
+    if (in >= 0) close(in);
+    if (failed) sh_print("unknown command\n");
+
+    /* The writers finish (or fail) once every reader has closed */
+    for (int i = 0; i < n - 1; i++)
+        if (pids[i] > 0) waitpid(pids[i], 0, 0);
+}
+
+/* ── memory limits ──────────────────────────────────────────────────── */
+
+static void ulimit_show(const char *label, int which)
+{
+    int kb = setlimit(which, -1);
+    sh_print(label);
+    if (kb <= 0) { sh_print("unlimited\n"); return; }
+    char buf[12];
+    int i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    while (kb) { buf[--i] = (char)('0' + kb % 10); kb /= 10; }
+    sh_print(&buf[i]);
+    sh_print(" kB\n");
+}
+
+/*
+ * ulimit [-m|-d kB]: show the limits, or set the resident-memory (-m) or
+ * heap (-d) limit of the shell, which every program it starts inherits.
+ * 0 removes the limit.
+ */
+static void run_ulimit(const char *args)
+{
+    while (*args == ' ') args++;
+    if (!*args) {
+        ulimit_show("rss:  ", LIMIT_RSS);
+        ulimit_show("heap: ", LIMIT_HEAP);
+        return;
+    }
+    int which = -1;
+    if (args[0] == '-' && args[1] == 'm') which = LIMIT_RSS;
+    if (args[0] == '-' && args[1] == 'd') which = LIMIT_HEAP;
+    args += 2;
+    while (*args == ' ') args++;
+    int kb = 0;
+    if (*args < '0' || *args > '9') which = -1;
+    while (*args >= '0' && *args <= '9') kb = kb * 10 + (*args++ - '0');
+    if (which < 0 || *args) {
+        sh_print("usage: ulimit [-m|-d kB]\n");
+        return;
+    }
+    setlimit(which, kb);
+}
+
 /* ── shell main ─────────────────────────────────────────────────────── */
 
 void main(void)
@@ -134,6 +239,13 @@ void main(void)
     int  cursor_pos = 0;
 
     for (;;) {
+        /* Reap finished background jobs so they don't linger as zombies */
+        {
+            int status;
+            while (waitpid(-1, &status, WNOHANG) > 0)
+                ;
+        }
+
         /* Print prompt (green) */
         if (cwd_path[0]) {
             sh_print_colored(cwd_path, COLOR_PROMPT);
@@ -220,11 +332,26 @@ void main(void)
             continue;
         }
 
+        /* wait: block until every background job has finished */
+        if (cmd[0]=='w' && cmd[1]=='a' && cmd[2]=='i' && cmd[3]=='t' && !cmd[4]) {
+            int status;
+            while (waitpid(-1, &status, 0) > 0)
+                ;
+            continue;
+        }
+
         /* exit */
         if (cmd[0]=='e' && cmd[1]=='x' && cmd[2]=='i' && cmd[3]=='t' && !cmd[4]) {
             exit(0);
         }
 
+        /* ulimit [-m|-d kB] */
+        if (cmd[0]=='u' && cmd[1]=='l' && cmd[2]=='i' && cmd[3]=='m' &&
+            cmd[4]=='i' && cmd[5]=='t' && (!cmd[6] || cmd[6] == ' ')) {
+            run_ulimit(&cmd[6]);
+            continue;
+        }
+
         /* cd [name] */
         {
             int is_cd = (cmd[0] == 'c' && cmd[1] == 'd');
@@ -240,6 +367,17 @@ void main(void)
             }
         }
 
+        /* a | b: pipeline */
+        {
+            int has_pipe = 0;
+            for (int i = 0; cmd[i]; i++)
+                if (cmd[i] == '|') has_pipe = 1;
+            if (has_pipe) {
+                run_pipeline(cmd);
+                continue;
+            }
+        }
+
         /* Strip trailing spaces, then detect trailing '&' for background exec */
         {
             int len = sh_strlen(cmd);
@@ -0,0 +1,91 @@
+/*
+ * sysstat.c - per-syscall call counts and latency
+ *
+ * Prints every syscall that has been called at least once since boot:
+ *
+ * syscall         calls     avg cycles
+ * write             412           2381
+ * getpid          60000            402
+ *
+ * avg cycles = TSC cycles spent in the kernel handler / calls.  Blocking
+ * calls (getchar, sleep, waitpid, exec) include the time spent waiting.
+ */
+
+#include "os.h"
+
+static const char *sc_names[NR_SYSCALLS] = {
+    "exit", "write", "read", "open", "close", "getchar", "setpos", "clrscr",
+    "getchar_nb", "readdir", "unlink", "mkdir", "rename", "exec", "chdir",
+    "getpos", "panic", "meminfo", "sbrk", "sleep", "yield", "waitpid",
+    "getpid", "sysstat", "lseek", "iostat", "mmap", "munmap", "pipe", "dup2",
+    "shmat", "shmdt", "send", "receive", "reply", "fork",
+    "thread", "join", "futex_wait", "futex_wake", "pageout",
+    "setlimit", "procinfo",
+};
+
+/* Write a right-justified decimal number in a field of `width` chars. */
+static void print_num(unsigned int n, int width)
+{
+    char buf[12];
+    int i = 0;
+    if (n == 0) { buf[i++] = '0'; }
+    else { while (n) { buf[i++] = (char)('0' + n % 10); n /= 10; } }
+    for (int sp = i; sp < width; sp++) write(STDOUT, " ", 1);
+    for (int d = i - 1; d >= 0; d--)
+        write(STDOUT, &buf[d], 1);
+}
+
+/* 64-by-32-bit division without libgcc; saturates at 0xFFFFFFFF. */
+static unsigned int div64(unsigned long long n, unsigned int d)
+{
+    unsigned int hi = (unsigned int)(n >> 32), lo = (unsigned int)n;
+    if (hi >= d) return 0xFFFFFFFFu;
+    unsigned int q, rem;
+    __asm__ ("divl %4" : "=a"(q), "=d"(rem) : "a"(lo), "d"(hi), "rm"(d));
+    return q;
+}
+
+void main(void)
+{
+    struct sysstat_entry st[NR_SYSCALLS];
+    int n = sysstat(st, NR_SYSCALLS);
+    if (n < 0) {
+        print("sysstat: failed\n");
+        exit(1);
+    }
+
+    print("syscall         calls     avg cycles\n");
+    for (int i = 0; i < n; i++) {
+        if (!st[i].count) continue;
+        int len = strlen(sc_names[i]);
+        print(sc_names[i]);
+        for (int sp = len; sp < 12; sp++) write(STDOUT, " ", 1);
+        print_num(st[i].count, 9);
+        print_num(div64(st[i].cycles, st[i].count), 15);
+        print("\n");
+    }
+
+    struct iostat io;
+    iostat(&io);
+    print("\ndisk reads:");
+    print_num(io.read_sectors, 9);
+    print(" sectors in");
+    print_num(io.read_cmds, 7);
+    print(" commands\n");
+    print("readahead: ");
+    print_num(io.ra_prefetched, 9);
+    print(" prefetched,");
+    print_num(io.ra_hits, 7);
+    print(" hits,");
+    print_num(io.ra_waste, 7);
+    print(" wasted\n");
+    print("write-back:");
+    print_num(io.wb_pages, 9);
+    print(" pages in");
+    print_num(io.wb_flushes, 7);
+    print(" flushes\n");
+    print("direct reads:");
+    print_num(io.rd_direct, 7);
+    print(" pages\n");
+    exit(0);
+}
@@ -0,0 +1,99 @@
+/*
+ * t_file — test streaming file I/O past the old 16 KB per-fd limit.
+ *
+ * Writes a 40000-byte pattern to T_FILE.DAT in odd-sized chunks, reads it
+ * back in different odd-sized chunks, checks every byte and that read()
+ * returns 0 at EOF.  Then opens the file N_OPEN times at once (more than
+ * fit in the inline part of the per-process fd table) and checks each fd
+ * reads from its own position, and finally deletes the file.  Also
+ * reads /bin/vi, which is not in the page cache yet, once in a single
+ * read() (whole pages go straight from disk into the buffer) and once in
+ * small chunks through the cache (readahead), and compares the two.
+ * read() and write() with a buffer outside the process must return -1.
+ * Prints "file: OK" on success.
+ */
+
+#define TEST_NAME "file"
+#define FILE_NAME  "T_FILE.DAT"
+#define TEST_FILE  FILE_NAME   /* removed by fail() */
+#include "os.h"
+
+#define FILE_SIZE  40000
+#define WR_CHUNK   1000
+#define RD_CHUNK   333
+#define N_OPEN     40
+#define BIN_NAME   "/bin/vi"
+#define BIN_MAX    16384
+#define BAD_BUF    ((char *)0x900000)   /* above the user page table */
+
+static unsigned char pattern(unsigned int i)
+{
+    return (unsigned char)(i * 7 + i / 251);
+}
+
+void main(void)
+{
+    static char buf[WR_CHUNK];
+
+    int fd = open(FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) fail("open for write");
+    for (unsigned int pos = 0; pos < FILE_SIZE; pos += WR_CHUNK) {
+        for (int i = 0; i < WR_CHUNK; i++)
+            buf[i] = (char)pattern(pos + i);
+        if (write(fd, buf, WR_CHUNK) != WR_CHUNK) fail("write");
+    }
+    if (close(fd) < 0) fail("close after write");
+
+    fd = open(FILE_NAME, O_RDONLY);
+    if (fd < 0) fail("open for read");
+    unsigned int total = 0;
+    for (;;) {
+        int n = read(fd, buf, RD_CHUNK);
+        if (n < 0) fail("read");
+        if (n == 0) break;
+        for (int i = 0; i < n; i++)
+            if ((unsigned char)buf[i] != pattern(total + i)) fail("data mismatch");
+        total += n;
+    }
+    close(fd);
+    if (total != FILE_SIZE) fail("size");
+
+    /* Many fds on the same file; fd i skips i bytes before reading */
+    static int fds[N_OPEN];
+    for (int i = 0; i < N_OPEN; i++) {
+        fds[i] = open(FILE_NAME, O_RDONLY);
+        if (fds[i] < 0) fail("open many");
+        if (i > 0 && read(fds[i], buf, i) != i) fail("read many");
+    }
+    for (int i = 0; i < N_OPEN; i++) {
+        if (read(fds[i], buf, 1) != 1 || (unsigned char)buf[0] != pattern(i))
+            fail("fd position");
+        if (close(fds[i]) < 0) fail("close many");
+    }
+
+    static char whole[BIN_MAX];
+    fd = open(BIN_NAME, O_RDONLY);
+    if (fd < 0) fail("open " BIN_NAME);
+    int end = lseek(fd, 0, SEEK_END);
+    if (end <= 0 || end > BIN_MAX) fail("size " BIN_NAME);
+    lseek(fd, 0, SEEK_SET);
+    if (read(fd, whole, BIN_MAX) != end) fail("read whole " BIN_NAME);
+    lseek(fd, 0, SEEK_SET);
+    total = 0;
+    for (;;) {
+        int n = read(fd, buf, RD_CHUNK);
+        if (n < 0) fail("read " BIN_NAME);
+        if (n == 0) break;
+        for (int i = 0; i < n; i++)
+            if (buf[i] != whole[total + i]) fail("direct read mismatch");
+        total += n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    if (read(fd, BAD_BUF, RD_CHUNK) != -1) fail("read to bad buffer");
+    close(fd);
+    if (total != (unsigned int)end) fail("size " BIN_NAME);
+    if (write(1, BAD_BUF, 1) != -1) fail("write from bad buffer");
+
+    if (unlink(FILE_NAME) < 0) fail("unlink");
+    pass();
+}
@@ -0,0 +1,67 @@
+/*
+ * t_fpu — test lazy FPU/SSE context switching.
+ *
+ * Runs a background copy of itself ("t_fpu child").  Each process loads
+ * its own values into XMM0 and onto the x87 stack, yields many times so
+ * the two processes keep preempting each other's FPU state, then checks
+ * that the registers still hold its own values.  Prints "fpu: OK".
+ *
+ * The program is built without -msse, so the compiler never touches the
+ * XMM registers itself; the asm below owns XMM0 for its whole lifetime.
+ */
+
+#include "os.h"
+
+#define N_YIELDS 200
+
+/* Returns 1 if XMM0 and ST(0) survived N_YIELDS context switches. */
+static int fpu_check(unsigned int seed)
+{
+    unsigned int in[4]  = { seed, seed * 3, seed * 5, seed * 7 };
+    unsigned int out[4] = { 0, 0, 0, 0 };
+    double       d_in   = (double)seed * 1.25;
+    double       d_out  = 0.0;
+
+    __asm__ volatile (
+        "movups %[in], %%xmm0\n"
+        "fldl   %[d_in]\n"
+        "mov    %[n], %%esi\n"
+        "1:\n"
+        "mov    %[nr], %%eax\n"
+        "int    $0x80\n"            /* yield() */
+        "dec    %%esi\n"
+        "jnz    1b\n"
+        "fstpl  %[d_out]\n"
+        "movups %%xmm0, %[out]\n"
+        : [out] "=m"(out), [d_out] "=m"(d_out)
+        : [in] "m"(in), [d_in] "m"(d_in), [n] "i"(N_YIELDS), [nr] "i"(SYS_YIELD)
+        : "eax", "esi", "memory", "cc"
+    );
+
+    for (int i = 0; i < 4; i++)
+        if (out[i] != in[i]) return 0;
+    return d_out == d_in;
+}
+
+void main(void)
+{
+    const char *args = get_args();
+
+    if (args[0] == 'c') {               /* "child" */
+        exit(fpu_check(0x5A5A0000u) ? 0 : 1);
+    }
+
+    int pid = exec_bg("t_fpu", "child");
+    if (pid < 0) {
+        print("fpu: FAIL exec_bg\n");
+        exit(1);
+    }
+
+    int ok = fpu_check(0x12340000u);
+    int status = -1;
+    if (waitpid(pid, &status, 0) != pid) ok = 0;
+    if (status != 0) ok = 0;
+
+    print(ok ? "fpu: OK\n" : "fpu: FAIL\n");
+    exit(ok ? 0 : 1);
+}
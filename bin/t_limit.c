@@ -0,0 +1,100 @@
+/*
+ * t_limit — test per-process memory limits and procinfo().
+ *
+ * Checks its own procinfo() entry and its parent's, then sets a 64 KB heap
+ * limit: sbrk() must reach it and fail past it, and a child ("t_limit
+ * inherit") must start with the same limit.  A second child ("t_limit
+ * rss") sets an RSS limit 32 KB above its resident size and fills 64 KB
+ * of heap: its own pages must go to swap, its RSS stay under the limit,
+ * and the data read back.  Then checks that no frames or swap slots leaked.
+ * Prints "limit: OK".
+ */
+
+#define TEST_NAME "limit"
+#include "os.h"
+
+#define HEAP  (64 * 1024)
+
+static struct procinfo procs[32];
+
+static int streq(const char *a, const char *b)
+{
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+/* procinfo() entry of pid, or 0 */
+static struct procinfo *find(int pid)
+{
+    int n = procinfo(procs, 32);
+    for (int i = 0; i < n; i++)
+        if (procs[i].pid == pid) return &procs[i];
+    return 0;
+}
+
+/* Child: an RSS limit pages our own heap out instead of failing */
+static void rss(void)
+{
+    struct procinfo *me = find(getpid());
+    if (!me) exit(10);
+    unsigned int limit = me->rss_kb + 32;
+    setlimit(LIMIT_RSS, (int)limit);
+
+    unsigned char *heap = sbrk(HEAP);
+    if (heap == (unsigned char *)-1) exit(11);
+    for (int i = 0; i < HEAP; i++) heap[i] = (unsigned char)(i * 13);
+    me = find(getpid());
+    if (!me || me->rss_kb > limit) exit(12);
+    if (me->swap_kb == 0) exit(13);
+    for (int i = 0; i < HEAP; i++)
+        if (heap[i] != (unsigned char)(i * 13)) exit(14);
+    exit(0);
+}
+
+static int run(const char *args)
+{
+    int status = -1;
+    int pid = exec_bg("t_limit", args);
+    if (pid < 0) fail("exec_bg");
+    if (waitpid(pid, &status, 0) != pid) fail("waitpid");
+    return status;
+}
+
+void main(void)
+{
+    const char *args = get_args();
+    if (args[0] == 'i') exit(setlimit(LIMIT_HEAP, -1) == 64 ? 0 : 1);   /* "inherit" */
+    if (args[0] == 'r') rss();                                           /* "rss"     */
+
+    struct procinfo *me = find(getpid());
+    if (!me) fail("no procinfo entry");
+    if (!streq(me->name, "t_limit") || me->state != 'R') fail("name or state");
+    if (me->rss_kb < 256 || me->heap_kb != 0 || me->rss_limit_kb || me->heap_limit_kb)
+        fail("initial entry");
+    unsigned int rss0 = me->rss_kb;
+    struct procinfo *parent = find(me->parent_pid);
+    if (!parent || parent->state != 'W') fail("parent entry");
+
+    if (setlimit(LIMIT_HEAP, 64) != 0) fail("setlimit");
+    if (sbrk(HEAP) == (void *)-1) fail("sbrk up to the limit");
+    if (sbrk(1) != (void *)-1) fail("sbrk past the limit");
+    me = find(getpid());
+    if (me->heap_kb != 64 || me->heap_limit_kb != 64) fail("heap accounting");
+    if (me->rss_kb != rss0 + 64) fail("rss accounting");
+    if (run("inherit") != 0) fail("limit not inherited");
+    if (setlimit(LIMIT_HEAP, 0) != 64) fail("setlimit old value");
+    if (setlimit(7, 0) != -1) fail("bad limit accepted");
+
+    struct meminfo m0;
+    meminfo(&m0);
+    if (m0.swap_total_kb == 0) fail("no swap file");
+    int status = run("rss");
+    if (status == 11) fail("sbrk failed under an RSS limit");
+    if (status == 12) fail("rss over the limit");
+    if (status == 13) fail("nothing went to swap");
+    if (status == 14) fail("data after swap-in");
+    if (status != 0)  fail("rss child status");
+    check_no_leak(&m0);
+
+    pass();
+}
@@ -0,0 +1,77 @@
+/*
+ * t_mmap — test mmap() of files.
+ *
+ * Writes a three-page pattern to T_MMAP.DAT and maps it MAP_SHARED
+ * read/write: checks the mapped bytes, writes through the mapping and
+ * checks read() sees the change at once and after munmap().  Then maps
+ * it MAP_PRIVATE and checks writes stay private, and checks the error
+ * cases (write mapping of a read-only fd, unlink while mapped).
+ * Deletes the file and prints "mmap: OK" on success.
+ */
+
+#define TEST_NAME "mmap"
+#define FILE_NAME  "T_MMAP.DAT"
+#define TEST_FILE  FILE_NAME   /* removed by fail() */
+#include "os.h"
+
+#define FILE_SIZE  10000
+
+static unsigned char pattern(unsigned int i)
+{
+    return (unsigned char)(i * 5 + i / 263);
+}
+
+/* Read one byte at pos through a fresh fd. */
+static int byte_at(unsigned int pos)
+{
+    unsigned char c;
+    int fd = open(FILE_NAME, O_RDONLY);
+    if (fd < 0) return -1;
+    lseek(fd, (int)pos, SEEK_SET);
+    int n = read(fd, (char *)&c, 1);
+    close(fd);
+    return n == 1 ? c : -1;
+}
+
+void main(void)
+{
+    static char buf[FILE_SIZE];
+
+    unlink(FILE_NAME);
+    int fd = open(FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) fail("create");
+    for (unsigned int i = 0; i < FILE_SIZE; i++) buf[i] = (char)pattern(i);
+    if (write(fd, buf, FILE_SIZE) != FILE_SIZE) fail("write");
+    close(fd);
+
+    /* Shared, read/write */
+    fd = open(FILE_NAME, O_RDWR);
+    if (fd < 0) fail("open O_RDWR");
+    unsigned char *m = mmap(fd, 0, PROT_READ | PROT_WRITE | MAP_SHARED);
+    if (m == MAP_FAILED) fail("mmap shared");
+    close(fd);                                  /* the mapping keeps the file */
+    for (unsigned int i = 0; i < FILE_SIZE; i++)
+        if (m[i] != pattern(i)) fail("mapped data");
+    m[5000] = 'M';
+    if (byte_at(5000) != 'M') fail("shared write not seen by read");
+    if (unlink(FILE_NAME) == 0) fail("unlink while mapped");
+    if (munmap(m) < 0) fail("munmap");
+    if (munmap(m) == 0) fail("munmap twice");
+    if (byte_at(5000) != 'M') fail("shared write lost");
+
+    /* Private */
+    fd = open(FILE_NAME, O_RDONLY);
+    if (fd < 0) fail("open O_RDONLY");
+    if (mmap(fd, 0, PROT_READ | PROT_WRITE | MAP_SHARED) != MAP_FAILED)
+        fail("shared write mapping of a read-only fd");
+    unsigned char *p = mmap(fd, 4096, PROT_READ | PROT_WRITE | MAP_PRIVATE);
+    if (p == MAP_FAILED) fail("mmap private");
+    if (p[100] != pattern(100)) fail("private data");
+    p[100] = 'P';
+    if (p[100] != 'P' || byte_at(100) != pattern(100)) fail("private write leaked");
+    munmap(p);
+    close(fd);
+
+    if (unlink(FILE_NAME) < 0) fail("unlink");
+    pass();
+}
@@ -0,0 +1,88 @@
+/*
+ * t_pipe — test pipe(), dup2() and stdin/stdout inheritance.
+ *
+ * Points its stdout at a pipe and starts a background copy of itself
+ * ("t_pipe child"), which inherits that stdout and writes N_BYTES of a
+ * known pattern to it — several times the pipe buffer, so the writer
+ * has to block on a full pipe and the reader on an empty one.  The
+ * parent reads everything back until EOF, checks every byte, then checks
+ * the error cases and that no frames leaked.  Prints "pipe: OK".
+ */
+
+#define TEST_NAME "pipe"
+#include "os.h"
+
+#define N_BYTES 20000
+
+static unsigned char pattern(unsigned int i)
+{
+    return (unsigned char)(i * 7 + (i >> 9));
+}
+
+/* Child: N_BYTES to stdout in odd-sized chunks */
+static void writer(void)
+{
+    static unsigned char buf[1000];
+    unsigned int off = 0;
+    while (off < N_BYTES) {
+        unsigned int n = N_BYTES - off < 777 ? N_BYTES - off : 777;
+        for (unsigned int i = 0; i < n; i++) buf[i] = pattern(off + i);
+        if (write(STDOUT, (const char *)buf, (int)n) != (int)n) exit(1);
+        off += n;
+    }
+    exit(0);
+}
+
+void main(void)
+{
+    const char *args = get_args();
+    if (args[0] == 'c') writer();      /* "child" */
+
+    int fds[2];
+
+    /* Warm up the file slab so the leak check below only sees the pipe */
+    if (pipe(fds) < 0) fail("pipe");
+    close(fds[0]);
+    close(fds[1]);
+
+    struct meminfo before;
+    meminfo(&before);
+
+    if (pipe(fds) < 0)                 fail("pipe");
+    if (fds[0] < 2 || fds[1] < 2)      fail("fd numbers");
+    if (lseek(fds[0], 0, SEEK_SET) != -1) fail("lseek on a pipe");
+    if (write(fds[0], "x", 1) != -1)   fail("write to the read end");
+
+    if (dup2(fds[1], STDOUT) != STDOUT) fail("dup2");
+    close(fds[1]);
+    int pid = exec_bg("t_pipe", "child");
+    close(STDOUT);                     /* back to the console */
+    if (pid < 0) fail("exec_bg");
+
+    static unsigned char buf[1500];
+    unsigned int total = 0;
+    for (;;) {
+        int n = read(fds[0], (char *)buf, sizeof(buf));
+        if (n < 0) fail("read");
+        if (n == 0) break;             /* EOF: the child closed the last write end */
+        for (int i = 0; i < n; i++)
+            if (buf[i] != pattern(total + (unsigned int)i)) fail("data");
+        total += (unsigned int)n;
+    }
+    if (total != N_BYTES) fail("byte count");
+
+    int status = -1;
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("child status");
+    if (read(fds[0], (char *)buf, 1) != 0) fail("EOF not sticky");
+    close(fds[0]);
+
+    /* No reader left: write fails instead of blocking */
+    if (pipe(fds) < 0) fail("pipe");
+    close(fds[0]);
+    if (write(fds[1], "x", 1) != -1) fail("write without a reader");
+    close(fds[1]);
+
+    check_no_leak(&before);
+
+    pass();
+}
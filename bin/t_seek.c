@@ -0,0 +1,82 @@
+/*
+ * t_seek — test lseek(), O_RDWR, O_APPEND and O_CREAT/O_TRUNC.
+ *
+ * Edits T_SEEK.DAT in place through one O_RDWR fd, appends to it with
+ * O_APPEND, writes past the end to create a zero-filled gap, truncates it,
+ * and checks the error cases (missing file without O_CREAT, wrong access
+ * mode, seeks past what the volume can hold).  Deletes the file and prints "seek: OK" on success.
+ */
+
+#define TEST_NAME "seek"
+#define FILE_NAME "T_SEEK.DAT"
+#define TEST_FILE  FILE_NAME   /* removed by fail() */
+#include "os.h"
+
+static int same(const char *a, const char *b, int n)
+{
+    for (int i = 0; i < n; i++)
+        if (a[i] != b[i]) return 0;
+    return 1;
+}
+
+void main(void)
+{
+    char buf[16];
+
+    unlink(FILE_NAME);
+    if (open(FILE_NAME, O_RDONLY) >= 0) fail("open without O_CREAT");
+
+    /* Read/write through one fd */
+    int fd = open(FILE_NAME, O_RDWR | O_CREAT | O_TRUNC);
+    if (fd < 0) fail("open O_RDWR|O_CREAT");
+    if (write(fd, "hello world", 11) != 11)        fail("write");
+    if (lseek(fd, 0, SEEK_SET) != 0)               fail("lseek SEEK_SET");
+    if (read(fd, buf, 5) != 5 || !same(buf, "hello", 5)) fail("read back");
+    if (lseek(fd, 6, SEEK_SET) != 6)               fail("lseek 6");
+    if (write(fd, "WORLD", 5) != 5)                fail("overwrite");
+    if (lseek(fd, 0, SEEK_END) != 11)              fail("lseek SEEK_END");
+    if (lseek(fd, -5, SEEK_CUR) != 6)              fail("lseek SEEK_CUR");
+    if (read(fd, buf, 16) != 5 || !same(buf, "WORLD", 5)) fail("read overwrite");
+    if (lseek(fd, -20, SEEK_CUR) != -1)            fail("negative offset");
+    if (lseek(fd, 0x7FFFFF00, SEEK_SET) != -1)     fail("offset past the volume");
+    if (lseek(fd, 0x7FFFFFFF, SEEK_CUR) != -1)     fail("offset overflow");
+    if (lseek(fd, 0, SEEK_CUR) != 11)              fail("position after failed lseek");
+    close(fd);
+
+    fd = open(FILE_NAME, O_RDONLY);
+    if (fd < 0) fail("reopen");
+    if (read(fd, buf, 16) != 11 || !same(buf, "hello WORLD", 11)) fail("contents");
+    if (write(fd, "x", 1) != -1)                   fail("write on O_RDONLY");
+    close(fd);
+
+    /* Append goes to the end no matter where the position is */
+    fd = open(FILE_NAME, O_WRONLY | O_APPEND);
+    if (fd < 0) fail("open O_APPEND");
+    lseek(fd, 0, SEEK_SET);
+    if (write(fd, "!", 1) != 1)                    fail("append");
+    if (lseek(fd, 0, SEEK_CUR) != 12)              fail("append position");
+    if (read(fd, buf, 1) != -1)                    fail("read on O_WRONLY");
+    close(fd);
+
+    /* Writing past the end leaves a zero-filled gap */
+    fd = open(FILE_NAME, O_RDWR);
+    if (fd < 0) fail("open O_RDWR");
+    if (lseek(fd, 2000, SEEK_SET) != 2000)         fail("lseek past end");
+    if (write(fd, "Z", 1) != 1)                    fail("write past end");
+    if (lseek(fd, 0, SEEK_END) != 2001)            fail("size after gap");
+    if (lseek(fd, 1999, SEEK_SET) != 1999)         fail("lseek into gap");
+    if (read(fd, buf, 4) != 2 || buf[0] != 0 || buf[1] != 'Z') fail("gap contents");
+    if (lseek(fd, 5, SEEK_SET) != 5 || read(fd, buf, 7) != 7 ||
+        !same(buf, " WORLD!", 7))                  fail("data before gap");
+    close(fd);
+
+    /* O_TRUNC empties it; O_TRUNC without write access is refused */
+    if (open(FILE_NAME, O_RDONLY | O_TRUNC) >= 0)  fail("O_RDONLY|O_TRUNC");
+    fd = open(FILE_NAME, O_WRONLY | O_TRUNC);
+    if (fd < 0) fail("open O_TRUNC");
+    if (lseek(fd, 0, SEEK_END) != 0)               fail("size after O_TRUNC");
+    close(fd);
+
+    if (unlink(FILE_NAME) < 0) fail("unlink");
+    pass();
+}
@@ -0,0 +1,77 @@
+/*
+ * t_shm — test shm_attach() / shm_detach().
+ *
+ * Creates a segment, fills it with a known pattern and attaches it a
+ * second time to check that both mappings alias the same frames.  Then
+ * starts a copy of itself ("t_shm child"), which attaches the segment by
+ * key without SHM_CREATE, checks the pattern and writes a reply into the
+ * last page.  The parent checks the reply, the error cases and that no
+ * frames leaked once the last mapping is gone.  Prints "shm: OK".
+ */
+
+#define TEST_NAME "shm"
+#include "os.h"
+
+#define SHM_KEY   0x5348   /* "SH" */
+#define SHM_BYTES (3 * 4096)
+#define REPLY_OFF (SHM_BYTES - 4)
+#define REPLY     0xC0FFEEu
+
+static unsigned int pattern(unsigned int i)
+{
+    return i * 2654435761u;
+}
+
+/* Child: attach the existing segment, check it, answer in the last word */
+static void child(void)
+{
+    unsigned int *m = shm_attach(SHM_KEY, 0, 0);
+    if (m == MAP_FAILED) exit(1);
+    for (unsigned int i = 0; i < REPLY_OFF / 4; i++)
+        if (m[i] != pattern(i)) exit(2);
+    m[REPLY_OFF / 4] = REPLY;
+    exit(0);   /* exit detaches */
+}
+
+void main(void)
+{
+    const char *args = get_args();
+    if (args[0] == 'c') child();       /* "child" */
+
+    struct meminfo before;
+    meminfo(&before);
+
+    if (shm_attach(SHM_KEY, 0, 0) != MAP_FAILED)         fail("attach without create");
+    if (shm_attach(0, 4096, SHM_CREATE) != MAP_FAILED)   fail("key 0");
+    if (shm_attach(SHM_KEY + 1, 0, SHM_CREATE) != MAP_FAILED) fail("size 0");
+
+    unsigned int *a = shm_attach(SHM_KEY, SHM_BYTES, SHM_CREATE);
+    if (a == MAP_FAILED) fail("create");
+    for (unsigned int i = 0; i < SHM_BYTES / 4; i++)
+        if (a[i] != 0) fail("not zeroed");
+    for (unsigned int i = 0; i < SHM_BYTES / 4; i++) a[i] = pattern(i);
+
+    unsigned int *b = shm_attach(SHM_KEY, 0, 0);
+    if (b == MAP_FAILED || b == a) fail("second attach");
+    if (b[100] != pattern(100)) fail("alias read");
+    b[1] = 0x1234;
+    if (a[1] != 0x1234) fail("alias write");
+    a[1] = pattern(1);
+    if (shm_attach(SHM_KEY, SHM_BYTES + 4096, 0) != MAP_FAILED) fail("larger than segment");
+    if (shm_detach(b) != 0) fail("detach");
+    if (shm_detach(b) != -1) fail("double detach");
+    if (munmap(a) != -1)     fail("munmap of a segment");
+
+    int pid = exec_bg("t_shm", "child");
+    if (pid < 0) fail("exec_bg");
+    int status = -1;
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("child status");
+    if (a[REPLY_OFF / 4] != REPLY) fail("reply");
+
+    if (shm_detach(a) != 0) fail("last detach");
+    if (shm_attach(SHM_KEY, 0, 0) != MAP_FAILED) fail("segment outlived its last detach");
+
+    check_no_leak(&before);
+
+    pass();
+}
@@ -0,0 +1,84 @@
+/*
+ * t_stack — test on-demand stack growth and the stack guard page.
+ *
+ * A child ("t_stack deep") recurses through 16 KB of stack frames, which
+ * the kernel maps page by page as the stack grows, checks every frame on
+ * the way back and that its argument string, in the page above the stack,
+ * survived.  A second child ("t_stack overflow") recurses without end and
+ * must die on the guard page with status 139.  Then checks that no frames
+ * leaked.  Prints "stack: OK".
+ */
+
+#define TEST_NAME "stack"
+#include "os.h"
+
+#define FRAME  1024
+#define DEPTH  16          /* 16 KB: past the single page mapped at exec */
+
+static int streq(const char *a, const char *b)
+{
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+/* Fill a frame per level, then check it after the deeper levels returned */
+static int recurse(int depth)
+{
+    volatile unsigned char buf[FRAME];
+    for (int i = 0; i < FRAME; i++) buf[i] = (unsigned char)(depth + i);
+    int bad = depth > 1 ? recurse(depth - 1) : 0;
+    for (int i = 0; i < FRAME; i++)
+        if (buf[i] != (unsigned char)(depth + i)) bad++;
+    return bad;
+}
+
+static volatile int never;   /* keeps forever() from looking endless to gcc */
+
+static int forever(int depth)
+{
+    volatile unsigned char buf[FRAME];
+    buf[0] = (unsigned char)depth;
+    if (never) return 0;
+    return forever(depth + 1) + buf[0];
+}
+
+static void deep(void)
+{
+    struct meminfo before, after;
+    meminfo(&before);
+    if (recurse(DEPTH) != 0)                  exit(10);
+    meminfo(&after);
+    if (after.phys_used_kb < before.phys_used_kb + 12) exit(11);   /* grew by >= 3 pages */
+    if (!streq(get_args(), "deep"))          exit(12);
+    exit(0);
+}
+
+static int run(const char *args)
+{
+    int status = -1;
+    int pid = exec_bg("t_stack", args);
+    if (pid < 0) fail("exec_bg");
+    if (waitpid(pid, &status, 0) != pid) fail("waitpid");
+    return status;
+}
+
+void main(void)
+{
+    const char *args = get_args();
+    if (args[0] == 'd') deep();                  /* "deep"     */
+    if (args[0] == 'o') exit(forever(0));        /* "overflow" */
+
+    int status = run("deep");                    /* also warms up kernel tables */
+    if (status == 10) fail("stack frames corrupted");
+    if (status == 11) fail("stack did not grow on demand");
+    if (status == 12) fail("args overwritten by the stack");
+    if (status != 0)  fail("deep child status");
+
+    struct meminfo before;
+    meminfo(&before);
+    if (run("overflow") != 139) fail("overflow did not hit the guard page");
+    if (run("deep") != 0)       fail("deep child status (second run)");
+    check_no_leak(&before);
+
+    pass();
+}
@@ -0,0 +1,95 @@
+/*
+ * t_swap — test paging out to the swap file and back.
+ *
+ * Fills 64 KB of heap, pages it out with pageout() and checks that the
+ * swap grew and physical memory shrank, then that the data reads back.
+ * Pages a stack page out and back, forks while the heap is in swap (the
+ * child reads it back and changes it, the parent must still see its own
+ * data), and runs a child that exits with its heap in swap.  Each time,
+ * every slot must be free again afterwards.  Checks that pageout() rejects
+ * ranges outside the user page table, and that no frames or slots leaked.
+ * Prints "swap: OK".
+ */
+
+#define TEST_NAME "swap"
+#include "os.h"
+
+#define HEAP   (64 * 1024)
+#define PAGES  (HEAP / 4096)
+
+static unsigned char *heap;
+
+static void fill(unsigned char seed)
+{
+    for (int i = 0; i < HEAP; i++) heap[i] = (unsigned char)(seed + i * 7);
+}
+
+static int check(unsigned char seed)
+{
+    for (int i = 0; i < HEAP; i++)
+        if (heap[i] != (unsigned char)(seed + i * 7)) return 0;
+    return 1;
+}
+
+static unsigned int swap_used(void)
+{
+    struct meminfo m;
+    meminfo(&m);
+    return m.swap_used_kb;
+}
+
+/* Child: leave the heap in swap and exit */
+static void leave(void)
+{
+    fill(9);
+    if (pageout(heap, HEAP) != PAGES) exit(1);
+    exit(0);
+}
+
+void main(void)
+{
+    heap = sbrk(HEAP);
+    if (heap == (unsigned char *)-1) fail("sbrk");
+    if (get_args()[0] == 'l') leave();     /* "leave" */
+
+    static struct meminfo m0, m1;   /* static: no stack growth in between */
+    meminfo(&m0);
+    if (m0.swap_total_kb == 0) fail("no swap file");
+
+    fill(1);
+    if (pageout(heap, HEAP) != PAGES) fail("pageout count");
+    meminfo(&m1);
+    if (m1.swap_used_kb != m0.swap_used_kb + HEAP / 1024) fail("swap not used");
+    if (m1.phys_used_kb + HEAP / 1024 != m0.phys_used_kb) fail("frames not freed");
+    if (!check(1)) fail("data after swap-in");
+    if (swap_used() != m0.swap_used_kb) fail("slots not freed on swap-in");
+
+    volatile int local = 1234;
+    if (pageout((const void *)&local, 4) != 1 || local != 1234) fail("stack page");
+
+    /* fork with the heap in swap: both sides share the slots */
+    if (pageout(heap, HEAP) != PAGES) fail("pageout before fork");
+    int status = -1;
+    int pid = fork();
+    if (pid < 0) fail("fork");
+    if (pid == 0) {
+        if (!check(1)) exit(10);
+        fill(5);
+        exit(check(5) ? 0 : 11);
+    }
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("child did not read the swapped heap");
+    if (!check(1)) fail("child write reached the parent");
+    if (swap_used() != m0.swap_used_kb) fail("slots leaked after fork");
+
+    pid = exec_bg("t_swap", "leave");
+    if (pid < 0) fail("exec_bg");
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("leave child status");
+    if (swap_used() != m0.swap_used_kb) fail("slots leaked at exit");
+
+    if (pageout((const void *)0x1000, 4096) != -1)   fail("pageout of kernel memory");
+    if (pageout((const void *)0xC00000, 4096) != -1) fail("pageout past the user page table");
+    if (pageout(heap, 0xFFFFF000u) != -1)            fail("pageout length wrapping around");
+    check_no_leak(&m0);
+
+    pass();
+}
@@ -0,0 +1,132 @@
+/*
+ * t_thread — test thread_create() / thread_join() and futex-based mutexes.
+ *
+ * Starts N_WORKERS threads that each add to a shared counter N_ITER times
+ * under a mutex (yielding inside the critical section to force
+ * contention) and fill their part of a heap buffer; the main thread joins
+ * them, checks their exit statuses, the counter and the buffer.  Then
+ * checks that the thread slots run out, that futex_wake() wakes no more
+ * sleepers than asked, that a fault on a thread's stack guard page ends only
+ * that thread (status 139), the error cases, that a process exiting with
+ * threads still blocked takes them along ("t_thread orphan"), and that no
+ * frames leaked.  Prints "thread: OK".
+ */
+
+#define TEST_NAME "thread"
+#include "os.h"
+
+#define N_WORKERS 4
+#define N_ITER    500
+#define N_SLOTS   8        /* threads per process besides the main one */
+#define CHUNK     1024
+
+static struct mutex  lock = MUTEX_INIT;
+static volatile int  counter;
+static volatile int  go;
+static unsigned char *buf;
+
+static int worker(void *arg)
+{
+    int id = (int)arg;
+    for (int i = 0; i < N_ITER; i++) {
+        mutex_lock(&lock);
+        int c = counter;
+        if (i % 50 == 0) yield();      /* let the others find the lock taken */
+        counter = c + 1;
+        mutex_unlock(&lock);
+    }
+    for (int i = 0; i < CHUNK; i++) buf[id * CHUNK + i] = (unsigned char)(id + i);
+    return 100 + id;
+}
+
+/* Sleep until go is set */
+static int sleeper(void *arg)
+{
+    (void)arg;
+    while (!go) futex_wait(&go, 0);
+    return 0;
+}
+
+/* Write to the guard page at the bottom of this thread's stack */
+static int overflow(void *arg)
+{
+    (void)arg;
+    volatile int local = 0;
+    volatile int *guard = (volatile int *)((unsigned int)&local & ~0x3FFFu);
+    *guard = local;
+    return 0;
+}
+
+/* Child: leave threads blocked and exit under them */
+static void orphan(void)
+{
+    for (int i = 0; i < 3; i++)
+        if (thread_create(sleeper, 0) < 0) exit(1);
+    yield();
+    exit(0);
+}
+
+void main(void)
+{
+    const char *args = get_args();
+    if (args[0] == 'o') orphan();      /* "orphan" */
+
+    buf = sbrk(N_WORKERS * CHUNK);
+    if (buf == (unsigned char *)-1) fail("sbrk");
+
+    /* Warm up: the first thread may grow kernel tables */
+    int status = -1;
+    int tid = thread_create(sleeper, 0);
+    go = 1;
+    futex_wake(&go, 1);
+    if (tid < 0 || thread_join(tid, &status) != tid || status != 0) fail("warm-up thread");
+    go = 0;
+
+    struct meminfo before;
+    meminfo(&before);
+
+    int tids[N_SLOTS];
+    for (int i = 0; i < N_WORKERS; i++) {
+        tids[i] = thread_create(worker, (void *)i);
+        if (tids[i] < 0) fail("thread_create");
+    }
+    for (int i = 0; i < N_WORKERS; i++)
+        if (thread_join(tids[i], &status) != tids[i] || status != 100 + i) fail("worker status");
+    if (counter != N_WORKERS * N_ITER) fail("counter: lost update");
+    if (lock.state != 0)               fail("mutex left locked");
+    for (int id = 0; id < N_WORKERS; id++)
+        for (int i = 0; i < CHUNK; i++)
+            if (buf[id * CHUNK + i] != (unsigned char)(id + i)) fail("heap write not shared");
+    if (thread_join(tids[0], &status) != -1) fail("second join");
+
+    /* Fill every slot with sleepers; wake one, then the rest */
+    for (int i = 0; i < N_SLOTS; i++) {
+        tids[i] = thread_create(sleeper, 0);
+        if (tids[i] < 0) fail("thread_create (all slots)");
+    }
+    if (thread_create(sleeper, 0) != -1) fail("more threads than slots");
+    yield();                           /* the sleepers reach futex_wait */
+    if (futex_wait(&go, 1) != -1) fail("futex_wait on a changed value");
+    go = 1;
+    int n1 = futex_wake(&go, 1);
+    int n2 = futex_wake(&go, N_SLOTS);
+    if (n1 != 1 || n2 < 0 || n1 + n2 > N_SLOTS) fail("futex_wake count");
+    for (int i = 0; i < N_SLOTS; i++)
+        if (thread_join(tids[i], &status) != tids[i] || status != 0) fail("sleeper status");
+
+    /* A stack overflow kills only the thread */
+    tid = thread_create(overflow, 0);
+    if (tid < 0) fail("thread_create (overflow)");
+    if (thread_join(tid, &status) != tid || status != 139) fail("guard page status");
+
+    if (thread_join(getpid(), &status) != -1) fail("join of the main thread");
+    if (thread_join(99999, &status) != -1)    fail("join of a missing thread");
+
+    int pid = exec_bg("t_thread", "orphan");
+    if (pid < 0) fail("exec_bg");
+    if (waitpid(pid, &status, 0) != pid || status != 0) fail("orphan status");
+
+    check_no_leak(&before);
+
+    pass();
+}
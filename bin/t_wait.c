@@ -0,0 +1,49 @@
+/*
+ * t_wait — test yield(), waitpid() and zombie reaping.
+ *
+ * Spawns three background copies of itself ("t_wait <code>"), each of which
+ * yields a few times and exits with <code>.  The parent reaps them with
+ * waitpid(), checks every exit status, and verifies that all physical
+ * memory went back to the PMM.  Prints "wait: OK" on success.
+ */
+
+#define TEST_NAME "wait"
+#include "os.h"
+
+#define N_CHILDREN 3
+
+void main(void)
+{
+    const char *args = get_args();
+
+    /* Child mode: exit code passed as a single digit */
+    if (args[0] >= '0' && args[0] <= '9') {
+        for (int i = 0; i < 5; i++)
+            yield();
+        exit(args[0] - '0');
+    }
+
+    struct meminfo before;
+    meminfo(&before);
+
+    static const char *codes[N_CHILDREN] = { "3", "5", "7" };
+    int pids[N_CHILDREN];
+    for (int i = 0; i < N_CHILDREN; i++) {
+        pids[i] = exec_bg("t_wait", codes[i]);
+        if (pids[i] < 0) fail("exec_bg");
+    }
+
+    /* Reap in reverse order of creation; the first blocks until it exits */
+    for (int i = N_CHILDREN - 1; i >= 0; i--) {
+        int status = -1;
+        if (waitpid(pids[i], &status, 0) != pids[i]) fail("waitpid");
+        if (status != codes[i][0] - '0')              fail("status");
+    }
+
+    int status;
+    if (waitpid(-1, &status, WNOHANG) != -1) fail("no children left");
+
+    check_no_leak(&before);
+
+    pass();
+}
@@ -0,0 +1,74 @@
+/*
+ * t_wb — test write-back of dirty file pages by the timer flusher.
+ *
+ * Writes T_WB.DAT (five 4 KB pages) and closes it, which leaves the data
+ * dirty in the kernel page cache.  Sleeps past the flusher's age limit
+ * without touching the file system and checks iostat() shows the pages
+ * were written back, then checks the size in the directory entry and the
+ * contents.  Deletes the file and prints "wb: OK" on success.
+ */
+
+#define TEST_NAME "wb"
+#define FILE_NAME  "T_WB.DAT"
+#define TEST_FILE  FILE_NAME   /* removed by fail() */
+#include "os.h"
+
+#define FILE_SIZE  20000
+#define CHUNK      500
+
+static unsigned char pattern(unsigned int i)
+{
+    return (unsigned char)(i * 11 + i / 509);
+}
+
+static int same(const char *a, const char *b)
+{
+    while (*a && *a == *b) { a++; b++; }
+    return *a == *b;
+}
+
+void main(void)
+{
+    static char buf[CHUNK];
+    static struct direntry ents[64];
+    struct iostat before, after;
+
+    unlink(FILE_NAME);
+    iostat(&before);
+
+    int fd = open(FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC);
+    if (fd < 0) fail("open for write");
+    for (unsigned int pos = 0; pos < FILE_SIZE; pos += CHUNK) {
+        for (int i = 0; i < CHUNK; i++)
+            buf[i] = (char)pattern(pos + i);
+        if (write(fd, buf, CHUNK) != CHUNK) fail("write");
+    }
+    if (close(fd) < 0) fail("close");
+
+    /* Nothing reads the disk meanwhile; only the timer can flush */
+    sleep(2500);
+    iostat(&after);
+    if (after.wb_pages - before.wb_pages < (FILE_SIZE + 4095) / 4096)
+        fail("pages not written back");
+
+    int n = readdir(ents, 64);
+    int found = 0;
+    for (int i = 0; i < n; i++) {
+        if (!same(ents[i].name, "t_wb.dat")) continue;
+        if (ents[i].size != FILE_SIZE) fail("size in directory");
+        found = 1;
+    }
+    if (!found) fail("not in directory");
+
+    fd = open(FILE_NAME, O_RDONLY);
+    if (fd < 0) fail("open for read");
+    for (unsigned int pos = 0; pos < FILE_SIZE; pos += CHUNK) {
+        if (read(fd, buf, CHUNK) != CHUNK) fail("read");
+        for (int i = 0; i < CHUNK; i++)
+            if ((unsigned char)buf[i] != pattern(pos + i)) fail("data mismatch");
+    }
+    close(fd);
+
+    if (unlink(FILE_NAME) < 0) fail("unlink");
+    pass();
+}
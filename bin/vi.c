@@ -108,7 +108,7 @@ static int llen(int li)
 static void binsert(int pos, char c)
 {
     if (buf_len >= MAX_BUF - 1) return;
-    for (int i = buf_len; i > pos; i--) buf[i] = buf[i - 1];
+    memmove(buf + pos + 1, buf + pos, (unsigned int)(buf_len - pos));
     buf[pos] = c;
     buf_len++;
     modified = 1;
@@ -118,7 +118,7 @@ static void binsert(int pos, char c)
 static void bdelete(int pos)
 {
     if (pos < 0 || pos >= buf_len) return;
-    for (int i = pos; i < buf_len - 1; i++) buf[i] = buf[i + 1];
+    memmove(buf + pos, buf + pos + 1, (unsigned int)(buf_len - pos - 1));
     buf_len--;
     modified = 1;
     rebuild();
@@ -213,6 +213,13 @@ static void load(void)
 {
     int fd = open(filename, O_RDONLY);
     if (fd < 0) { buf_len = 0; rebuild(); return; }
+    /* Refuse rather than silently truncate on the next save */
+    if (lseek(fd, 0, SEEK_END) > MAX_BUF - 1) {
+        close(fd);
+        print("vi: file too large (max 16383 bytes)\n");
+        exit(1);
+    }
+    lseek(fd, 0, SEEK_SET);
     int n = read(fd, buf, MAX_BUF - 1);
     buf_len = (n > 0) ? n : 0;
     close(fd);
@@ -221,7 +228,7 @@ static void load(void)
 
 static void save(void)
 {
-    int fd = open(filename, O_WRONLY);
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC);
     if (fd < 0) {
         scopy(msg, "ERROR: cannot open for writing", sizeof(msg));
         return;
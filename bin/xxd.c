@@ -1,6 +1,15 @@
 /* xxd.c — minimal hexdump utility for YOLO-OS
  *
- * Usage: run xxd <file>
+ * Usage: run xxd [-s <offset>] [<file>]
+ *
+ * -s seeks to <offset> (decimal, or hex with 0x) before dumping.
+ * Without <file> stdin is dumped until EOF (e.g. "ls | xxd"); -s then
+ * skips that many bytes.
+ *
+ * The file is mmap()ed, so only the pages the dump reaches are loaded.
+ * If it cannot be mapped it is read a page at a time instead, each read
+ * ending on a 4 KB file boundary so whole pages go from disk straight
+ * into buf.
  *
  * Output format (16 bytes per line):
  *   00000000: 4865 6c6c 6f2c 2077 6f72 6c64 210a       Hello, world!.
@@ -8,6 +17,8 @@
 
 #include "os.h"
 
+#define PAGE 4096
+
 static const char HEX[] = "0123456789abcdef";
 
 static void put_hex_byte(unsigned char b)
@@ -29,12 +40,109 @@ static void put_offset(unsigned int off)
     write(STDOUT, buf, 8);
 }
 
+/* Print one line of up to 16 bytes starting at file offset off. */
+static void dump_line(const unsigned char *p, int n, unsigned int off)
+{
+    put_offset(off);
+    print(": ");
+
+    /* hex bytes — 8 groups of 2 bytes */
+    int i;
+    for (i = 0; i < 16; i += 2) {
+        if (i > 0) write(STDOUT, " ", 1);
+        if (i     < n) { put_hex_byte(p[i]);     } else { print("  "); }
+        if (i + 1 < n) { put_hex_byte(p[i + 1]); } else { print("  "); }
+    }
+
+    print("  ");
+
+    /* ASCII sidebar */
+    for (i = 0; i < n; i++) {
+        unsigned char c = p[i];
+        char ch = (c >= 0x20 && c <= 0x7e) ? (char)c : '.';
+        write(STDOUT, &ch, 1);
+    }
+
+    print("\n");
+}
+
+/* Parse a decimal or 0x-prefixed hex number; advances *p past it. */
+static unsigned int parse_num(const char **p)
+{
+    const char *s = *p;
+    unsigned int v = 0;
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        s += 2;
+        for (;;) {
+            char c = *s;
+            if      (c >= '0' && c <= '9') v = v * 16 + (unsigned int)(c - '0');
+            else if (c >= 'a' && c <= 'f') v = v * 16 + (unsigned int)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') v = v * 16 + (unsigned int)(c - 'A' + 10);
+            else break;
+            s++;
+        }
+    } else {
+        while (*s >= '0' && *s <= '9') v = v * 10 + (unsigned int)(*s++ - '0');
+    }
+    *p = s;
+    return v;
+}
+
+/* Dump fd from its current position, which is file offset start, to EOF. */
+static void dump_fd(int fd, unsigned int start)
+{
+    /* Up to 15 bytes left over from the previous read, then one page */
+    static unsigned char buf[16 + PAGE];
+    unsigned int offset = start;   /* file offset of buf[at]     */
+    unsigned int pos    = start;   /* file offset of the next read */
+    int have = 0, at = 0, eof = 0;
+
+    for (;;) {
+        if (have - at < 16 && !eof) {
+            memmove(buf, buf + at, (unsigned int)(have - at));
+            have -= at;
+            at = 0;
+            int n = read(fd, (char *)buf + have, PAGE - pos % PAGE);
+            if (n <= 0) eof = 1;
+            else { have += n; pos += (unsigned int)n; }
+            continue;
+        }
+        int n = have - at < 16 ? have - at : 16;
+        if (n == 0) break;
+        dump_line(buf + at, n, offset);
+        at     += n;
+        offset += (unsigned int)n;
+    }
+}
+
+/* stdin cannot seek: read and drop the first start bytes. */
+static void dump_stdin(unsigned int start)
+{
+    static char skip[256];
+    unsigned int off = 0;
+    while (off < start) {
+        unsigned int want = start - off < sizeof(skip) ? start - off : sizeof(skip);
+        int n = read(STDIN, skip, (int)want);
+        if (n <= 0) return;
+        off += (unsigned int)n;
+    }
+    dump_fd(STDIN, start);
+}
+
 void main(void)
 {
     const char *filename = get_args();
+    unsigned int start = 0;
+
+    if (filename && filename[0] == '-' && filename[1] == 's' && filename[2] == ' ') {
+        filename += 3;
+        while (*filename == ' ') filename++;
+        start = parse_num(&filename);
+        while (*filename == ' ') filename++;
+    }
     if (!filename || !filename[0]) {
-        print("usage: run xxd <file>\n");
-        exit(1);
+        dump_stdin(start);
+        exit(0);
     }
 
     int fd = open(filename, O_RDONLY);
@@ -45,38 +153,23 @@ void main(void)
         exit(1);
     }
 
-    unsigned char buf[16];
-    unsigned int offset = 0;
-
-    for (;;) {
-        int n = read(fd, (char *)buf, 16);
-        if (n <= 0) break;
-
-        /* offset */
-        put_offset(offset);
-        print(": ");
-
-        /* hex bytes — 8 groups of 2 bytes */
-        int i;
-        for (i = 0; i < 16; i += 2) {
-            if (i > 0) write(STDOUT, " ", 1);
-            if (i     < n) { put_hex_byte(buf[i]);     } else { print("  "); }
-            if (i + 1 < n) { put_hex_byte(buf[i + 1]); } else { print("  "); }
-        }
-
-        print("  ");
-
-        /* ASCII sidebar */
-        for (i = 0; i < n; i++) {
-            unsigned char c = buf[i];
-            char ch = (c >= 0x20 && c <= 0x7e) ? (char)c : '.';
-            write(STDOUT, &ch, 1);
+    int size = lseek(fd, 0, SEEK_END);
+    const unsigned char *map = size > 0 ? mmap(fd, 0, PROT_READ | MAP_SHARED) : MAP_FAILED;
+    if (map != MAP_FAILED) {
+        for (unsigned int off = start; off < (unsigned int)size; off += 16) {
+            unsigned int n = (unsigned int)size - off;
+            dump_line(map + off, n < 16 ? (int)n : 16, off);
         }
-
-        print("\n");
-        offset += (unsigned int)n;
+        munmap((void *)map);
+        close(fd);
+        exit(0);
     }
 
+    if (lseek(fd, (int)start, SEEK_SET) < 0) {
+        print("xxd: cannot seek\n");
+        exit(1);
+    }
+    dump_fd(fd, start);
     close(fd);
     exit(0);
 }
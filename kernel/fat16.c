@@ -2,7 +2,8 @@
  * fat16.c - FAT16 read/write filesystem driver
  *
  * Supports: root directory files (8.3 names), read, write/create, listdir,
- *           subdirectories (mkdir, cd, delete, rename).
+ *           subdirectories (mkdir, cd, delete, rename), streaming
+ *           open/pread/pwrite for the kernel fd layer.
  * Does NOT support: long filenames, timestamps, extending directory clusters.
  *
  * Disk access: calls ata_read_sector() / ata_write_sector() from kernel.c
@@ -12,9 +13,14 @@ typedef unsigned char  u8;
 typedef unsigned short u16;
 typedef unsigned int   u32;
 
+#include "fat16.h"
+#include "memops.h"
+
 /* Provided by kernel.c */
 extern int ata_read_sector(unsigned int lba, unsigned short *buf);
+extern int ata_read_sectors(unsigned int lba, unsigned int count, unsigned short *buf);
 extern int ata_write_sector(unsigned int lba, const unsigned short *buf);
+extern int ata_write_sectors(unsigned int lba, unsigned int count, const unsigned short *buf);
 
 /* ============================================================
  * LE integer helpers (byte-array <-> integer)
@@ -56,6 +62,8 @@ static u16 g_root_lba;      /* LBA of root directory                      */
 static u16 g_root_count;    /* max number of root directory entries       */
 static u16 g_root_sectors;  /* sectors occupied by root directory         */
 static u16 g_data_lba;      /* LBA of data area (cluster 2 starts here)  */
+static u32 g_max_cluster;   /* one past the last cluster on the disk      */
+static u32 g_free_clusters; /* free data clusters, counted at init        */
 static int g_initialized = 0;
 static u16 g_cwd_cluster = 0;   /* 0 = root directory */
 
@@ -70,6 +78,16 @@ static u16 g_cwd_cluster = 0;   /* 0 = root directory */
 static u16 g_sec0[256];
 static u16 g_sec1[256];
 
+/* ============================================================
+ * One-sector cache of the first FAT copy for fat_get().  Streaming a
+ * file calls fat_get once per cluster; with 1-sector clusters that would
+ * otherwise double the disk reads.  fat_set writes through and keeps the
+ * cached copy coherent.  LBA 0 is the boot sector, so 0 means "empty".
+ * ============================================================ */
+
+static u16 g_fat_cache[256];
+static u32 g_fat_cache_lba = 0;
+
 /* ============================================================
  * fat16_init — parse BPB from sector 0 of IDE disk
  * Returns 0 on success, -1 on error.
@@ -79,6 +97,7 @@ int fat16_init(void)
 {
     g_initialized = 0;
     g_cwd_cluster = 0;
+    g_fat_cache_lba = 0;
 
     if (ata_read_sector(0, g_sec0) < 0)
         return -1;
@@ -95,6 +114,8 @@ int fat16_init(void)
     u8  num_fats = bpb[16];         /* number of FATs       */
     u16 root_cnt = rd16(bpb + 17);  /* root entry count     */
     u16 fat_size = rd16(bpb + 22);  /* sectors per FAT      */
+    u32 total    = rd16(bpb + 19);  /* total sectors        */
+    if (total == 0) total = rd32(bpb + 32);
 
     if (bps != 512 || spc == 0 || num_fats == 0 || fat_size == 0)
         return -1;
@@ -107,6 +128,19 @@ int fat16_init(void)
     g_root_lba     = (u16)(g_fat_lba + g_num_fats * g_fat_size);
     g_root_sectors = (u16)((root_cnt * 32 + 511) / 512);
     g_data_lba     = (u16)(g_root_lba + g_root_sectors);
+    if (total <= g_data_lba) return -1;
+    g_max_cluster  = (total - g_data_lba) / spc + 2;
+    if (g_max_cluster > (u32)fat_size * 256) g_max_cluster = (u32)fat_size * 256;
+
+    g_free_clusters = 0;
+    for (u32 s = 0; s < g_fat_size; s++) {
+        if (ata_read_sector((u32)(g_fat_lba + s), g_sec0) < 0) return -1;
+        for (u32 i = 0; i < 256; i++) {
+            u32 c = s * 256 + i;
+            if (c >= 2 && c < g_max_cluster && rd16((u8 *)g_sec0 + i * 2) == 0x0000)
+                g_free_clusters++;
+        }
+    }
 
     g_initialized = 1;
     return 0;
@@ -123,10 +157,15 @@ static u16 fat_get(u16 cluster)
     u16 entry_idx  = (u16)(cluster % 256);
     u32 lba = (u32)(g_fat_lba + sector_off);
 
-    if (ata_read_sector(lba, g_sec0) < 0)
-        return 0xFFFF;
+    if (lba != g_fat_cache_lba) {
+        if (ata_read_sector(lba, g_fat_cache) < 0) {
+            g_fat_cache_lba = 0;
+            return 0xFFFF;
+        }
+        g_fat_cache_lba = lba;
+    }
 
-    return rd16((u8 *)g_sec0 + entry_idx * 2);
+    return g_fat_cache[entry_idx];
 }
 
 /* Write val into FAT entry for cluster c (updates every FAT copy). */
@@ -140,6 +179,7 @@ static int fat_set(u16 cluster, u16 val)
         if (ata_read_sector(lba, g_sec0) < 0) return -1;
         wr16((u8 *)g_sec0 + entry_idx * 2, val);
         if (ata_write_sector(lba, g_sec0) < 0) return -1;
+        if (lba == g_fat_cache_lba) g_fat_cache[entry_idx] = val;
     }
     return 0;
 }
@@ -160,9 +200,11 @@ static u16 fat_alloc(void)
         for (int i = 0; i < 256; i++) {
             u16 entry   = rd16(p + i * 2);
             u16 cluster = (u16)(s * 256 + i);
+            if (cluster >= g_max_cluster) return 0;
             if (entry == 0x0000 && cluster >= 2) {
                 if (fat_set(cluster, 0xFFFF) < 0)
                     return 0;
+                g_free_clusters--;
                 return cluster;
             }
         }
@@ -170,12 +212,55 @@ static u16 fat_alloc(void)
     return 0;  /* disk full */
 }
 
+/*
+ * Find n free clusters in a row and chain them together (first -> ... ->
+ * last = 0xFFFF).  Each FAT sector touched is rewritten once per copy
+ * instead of once per entry.  Returns the first cluster, or 0 if there
+ * is no run that long.
+ */
+static u16 fat_alloc_run(u32 n)
+{
+    u32 start = 0, len = 0;
+
+    for (u32 s = 0; s < g_fat_size && len < n; s++) {
+        if (ata_read_sector((u32)(g_fat_lba + s), g_sec0) < 0) return 0;
+        u8 *p = (u8 *)g_sec0;
+        for (u32 i = 0; i < 256 && len < n; i++) {
+            u32 c = s * 256 + i;
+            if (c >= 2 && c < g_max_cluster && rd16(p + i * 2) == 0x0000) {
+                if (len == 0) start = c;
+                len++;
+            } else {
+                len = 0;
+            }
+        }
+    }
+    if (len < n) return 0;
+
+    for (u8 fat = 0; fat < g_num_fats; fat++) {
+        u32 c = start;
+        while (c < start + n) {
+            u32 lba = (u32)(g_fat_lba + (u32)fat * g_fat_size + c / 256);
+            if (ata_read_sector(lba, g_sec0) < 0) return 0;
+            u8 *p = (u8 *)g_sec0;
+            do {
+                wr16(p + (c % 256) * 2, (u16)(c + 1 < start + n ? c + 1 : 0xFFFF));
+                c++;
+            } while (c < start + n && c % 256 != 0);
+            if (ata_write_sector(lba, g_sec0) < 0) return 0;
+        }
+    }
+    g_fat_cache_lba = 0;   /* cached FAT sector may be stale */
+    g_free_clusters -= n;
+    return (u16)start;
+}
+
 /* Free the cluster chain starting at cluster (mark all entries as 0x0000). */
 static void free_cluster_chain(u16 cluster)
 {
     while (cluster >= 2 && cluster < 0xFFF0) {
         u16 next = fat_get(cluster);
-        fat_set(cluster, 0x0000);
+        if (fat_set(cluster, 0x0000) == 0) g_free_clusters++;
         cluster = next;
     }
 }
@@ -360,12 +445,15 @@ int fat16_listdir(void (*cb)(const char *name, unsigned int size, int is_dir))
     return 0;
 }
 
-/* Forward declarations for path helpers defined later in this file */
+/* Forward declarations for helpers defined later in this file */
 static int path_has_sep(const char *p);
 static int fat16_resolve_path(const char *path, char *name_out);
+static int open_in_cwd(const char *filename, int flags, struct fat16_file *f);
 
 /* ============================================================
  * fat16_read — read a named file from the cwd into buf.
+ * Goes through fat16_pread, so contiguous clusters are fetched with
+ * one multi-sector command.
  * Returns number of bytes read, or -1 on error / file not found.
  * ============================================================ */
 
@@ -382,66 +470,9 @@ int fat16_read(const char *filename, unsigned char *buf, unsigned int max_bytes)
         return r;
     }
 
-    u8 fat_name[11];
-    str_to_fat83(filename, fat_name);
-
-    /* Search cwd for the file */
-    u16 first_cluster = 0;
-    u32 file_size     = 0;
-    int found         = 0;
-
-    for (u32 s = 0; !found; s++) {
-        u32 lba = dir_sector_lba(g_cwd_cluster, s);
-        if (!lba) break;
-        if (ata_read_sector(lba, g_sec0) < 0) return -1;
-
-        u8 *p = (u8 *)g_sec0;
-        for (int e = 0; e < 16; e++) {
-            u8 *ent = p + e * 32;
-
-            if (ent[0] == 0x00) goto read_not_found;
-            if (ent[0] == 0xE5) continue;
-
-            u8 attr = ent[11];
-            if (attr == FAT_ATTR_LFN)                 continue;
-            if (attr & (FAT_ATTR_DIR | FAT_ATTR_VOLUME)) continue;
-
-            if (fat83_match(ent, fat_name)) {
-                first_cluster = rd16(ent + 26);
-                file_size     = rd32(ent + 28);
-                found = 1;
-                break;
-            }
-        }
-    }
-
-read_not_found:
-    if (!found)            return -1;
-    if (first_cluster < 2) return 0;   /* empty file */
-
-    /* Follow cluster chain and copy data */
-    unsigned int bytes_read = 0;
-    u16 cluster = first_cluster;
-
-    while (cluster >= 2 && cluster < 0xFFF0 && bytes_read < max_bytes) {
-        u32 clus_lba = (u32)(g_data_lba + (u32)(cluster - 2) * g_spc);
-
-        for (u8 si = 0; si < g_spc && bytes_read < max_bytes; si++) {
-            if (ata_read_sector(clus_lba + si, g_sec0) < 0) return -1;
-
-            u8 *p = (u8 *)g_sec0;
-            unsigned int to_copy = 512;
-            if (bytes_read + to_copy > max_bytes)  to_copy = max_bytes  - bytes_read;
-            if (bytes_read + to_copy > file_size)  to_copy = (unsigned int)(file_size - bytes_read);
-
-            for (unsigned int i = 0; i < to_copy; i++)
-                buf[bytes_read + i] = p[i];
-            bytes_read += to_copy;
-        }
-        cluster = fat_get(cluster);
-    }
-
-    return (int)bytes_read;
+    struct fat16_file f;
+    if (open_in_cwd(filename, 0, &f) < 0) return -1;
+    return fat16_pread(&f, 0, buf, max_bytes);
 }
 
 /* ============================================================
@@ -532,12 +563,11 @@ dir_scan_done:
             u8 *p = (u8 *)g_sec0;
 
             /* Zero-fill buffer, then copy remaining data (partial last sector) */
-            for (int i = 0; i < 512; i++) p[i] = 0;
+            memset(p, 0, 512);
             if (written < size) {
                 unsigned int to_copy = size - written;
                 if (to_copy > 512) to_copy = 512;
-                for (unsigned int i = 0; i < to_copy; i++)
-                    p[i] = data[written + i];
+                memcpy(p, data + written, to_copy);
                 written += to_copy;
             }
 
@@ -562,6 +592,327 @@ dir_scan_done:
     return 0;
 }
 
+/* ============================================================
+ * Streaming file access — fat16_open / fat16_pread / fat16_pwrite /
+ * fat16_sync.  Used by the kernel fd layer: data moves one sector at a
+ * time between the caller's buffer and the cluster chain, so there is
+ * no size limit and open costs one directory lookup.
+ * ============================================================ */
+
+/*
+ * Open (and optionally create) a file in the cwd.
+ * Returns 0 on success, -1 if not found, a directory, or I/O error.
+ */
+static int open_in_cwd(const char *filename, int flags, struct fat16_file *f)
+{
+    u8 fat_name[11];
+    str_to_fat83(filename, fat_name);
+
+    u32 free_lba = 0;
+    int free_ent = -1;
+
+    for (u32 s = 0; s < DIR_MAX_SECTORS; s++) {
+        u32 lba = dir_sector_lba(g_cwd_cluster, s);
+        if (!lba) break;
+        if (ata_read_sector(lba, g_sec1) < 0) return -1;
+
+        u8 *p = (u8 *)g_sec1;
+        for (int e = 0; e < 16; e++) {
+            u8 *ent = p + e * 32;
+
+            if (ent[0] == 0x00 || ent[0] == 0xE5) {
+                if (free_ent < 0) { free_lba = lba; free_ent = e; }
+                if (ent[0] == 0x00) goto open_scan_done;
+                continue;
+            }
+
+            u8 attr = ent[11];
+            if (attr == FAT_ATTR_LFN)   continue;
+            if (attr & FAT_ATTR_VOLUME) continue;
+            if (!fat83_match(ent, fat_name)) continue;
+            if (attr & FAT_ATTR_DIR) return -1;
+
+            f->first_cluster = rd16(ent + 26);
+            f->size          = rd32(ent + 28);
+            f->dirent_lba    = lba;
+            f->dirent_off    = (u16)(e * 32);
+            f->cur_cluster = f->first_cluster;
+            f->cur_index   = 0;
+            f->dirty       = 0;
+            return 0;
+        }
+    }
+
+open_scan_done:
+    if (!(flags & FAT16_CREATE) || free_ent < 0) return -1;
+
+    if (ata_read_sector(free_lba, g_sec1) < 0) return -1;
+    u8 *ent = (u8 *)g_sec1 + free_ent * 32;
+    for (int i = 0; i < 32; i++) ent[i] = 0;
+    for (int i = 0; i < 11; i++) ent[i] = fat_name[i];
+    ent[11] = FAT_ATTR_ARCHIVE;
+    if (ata_write_sector(free_lba, g_sec1) < 0) return -1;
+
+    f->first_cluster = 0;
+    f->size          = 0;
+    f->dirent_lba    = free_lba;
+    f->dirent_off    = (u16)(free_ent * 32);
+    f->cur_cluster   = 0;
+    f->cur_index     = 0;
+    f->dirty         = 0;
+    return 0;
+}
+
+int fat16_open(const char *path, int flags, struct fat16_file *f)
+{
+    if (!g_initialized) return -1;
+
+    if (path_has_sep(path)) {
+        u16 saved = g_cwd_cluster;
+        char name[13];
+        if (fat16_resolve_path(path, name) < 0) { g_cwd_cluster = saved; return -1; }
+        int r = open_in_cwd(name, flags, f);
+        g_cwd_cluster = saved;
+        return r;
+    }
+    return open_in_cwd(path, flags, f);
+}
+
+/*
+ * Return cluster number idx of the file's chain (0 = first cluster).
+ * Walks forward from the cached position when possible.  Returns 0 if
+ * the chain is shorter; the cache is then left on the last cluster,
+ * which is exactly what fat16_pwrite needs to link a new one.
+ */
+static u16 file_cluster(struct fat16_file *f, u32 idx)
+{
+    if (f->first_cluster < 2) return 0;
+    if (f->cur_cluster < 2 || idx < f->cur_index) {
+        f->cur_cluster = f->first_cluster;
+        f->cur_index   = 0;
+    }
+    while (f->cur_index < idx) {
+        u16 next = fat_get(f->cur_cluster);
+        if (next < 2 || next >= 0xFFF0) return 0;
+        f->cur_cluster = next;
+        f->cur_index++;
+    }
+    return f->cur_cluster;
+}
+
+#define READ_RUN_MAX 128   /* sectors per multi-sector read/write command */
+
+/*
+ * Read up to len bytes at file offset pos.  Whole aligned sectors go
+ * straight into buf, as many physically consecutive ones per command as
+ * the chain allows; partial ones are bounced through g_sec0.
+ * Returns bytes read (0 at EOF) or -1 on I/O error.
+ */
+int fat16_pread(struct fat16_file *f, unsigned int pos,
+                unsigned char *buf, unsigned int len)
+{
+    if (pos >= f->size) return 0;
+    if (len > f->size - pos) len = f->size - pos;
+
+    u32 clus_bytes = (u32)g_spc * 512;
+    u32 done = 0;
+
+    while (done < len) {
+        u32 off = pos + done;
+        u16 c = file_cluster(f, off / clus_bytes);
+        if (!c) return -1;   /* chain shorter than size: corrupt */
+
+        u32 lba = (u32)(g_data_lba + (u32)(c - 2) * g_spc + (off % clus_bytes) / 512);
+        u32 in  = off % 512;
+        u32 n   = 512 - in;
+        if (n > len - done) n = len - done;
+
+        if (n == 512) {
+            /* Extend the run while the next sector is the next LBA */
+            u32 count = 1;
+            while (count < READ_RUN_MAX && len - done >= (count + 1) * 512) {
+                u32 noff = off + count * 512;
+                u16 nc = file_cluster(f, noff / clus_bytes);
+                if (!nc) break;
+                u32 nlba = (u32)(g_data_lba + (u32)(nc - 2) * g_spc + (noff % clus_bytes) / 512);
+                if (nlba != lba + count) break;
+                count++;
+            }
+            if (ata_read_sectors(lba, count, (u16 *)(buf + done)) < 0) return -1;
+            n = count * 512;
+        } else {
+            if (ata_read_sector(lba, g_sec0) < 0) return -1;
+            u8 *p = (u8 *)g_sec0;
+            memcpy(buf + done, p + in, n);
+        }
+        done += n;
+    }
+    return (int)done;
+}
+
+/*
+ * Write len bytes at file offset pos.  Clusters are allocated and linked
+ * one at a time as the write runs past the end of the chain; a pos past
+ * the end first fills the gap with zeros.  Returns bytes written (short
+ * on disk full) or -1.  The directory entry is only updated by fat16_sync.
+ */
+int fat16_pwrite(struct fat16_file *f, unsigned int pos,
+                 const unsigned char *buf, unsigned int len)
+{
+    static const u8 zeros[512];
+    while (f->size < pos) {
+        u32 gap = pos - f->size;
+        if (gap > 512) gap = 512;
+        if (fat16_pwrite(f, f->size, zeros, gap) != (int)gap) return -1;
+    }
+
+    u32 clus_bytes = (u32)g_spc * 512;
+    u32 done = 0;
+
+    while (done < len) {
+        u32 off = pos + done;
+        u32 idx = off / clus_bytes;
+        u16 c = file_cluster(f, idx);
+
+        if (!c) {
+            /* Past the end of the chain: append one cluster */
+            c = fat_alloc();
+            if (c == 0) break;   /* disk full */
+            if (f->first_cluster < 2) {
+                f->first_cluster = c;
+                f->dirty = 1;
+            } else if (fat_set(f->cur_cluster, c) < 0) {
+                return -1;
+            }
+            f->cur_cluster = c;
+            f->cur_index   = idx;
+        }
+
+        u32 lba = (u32)(g_data_lba + (u32)(c - 2) * g_spc + (off % clus_bytes) / 512);
+        u32 in  = off % 512;
+        u32 n   = 512 - in;
+        if (n > len - done) n = len - done;
+
+        if (n == 512) {
+            /* Extend the run through clusters that are already allocated */
+            u32 count = 1;
+            while (count < READ_RUN_MAX && len - done >= (count + 1) * 512) {
+                u32 noff = off + count * 512;
+                u16 nc = file_cluster(f, noff / clus_bytes);
+                if (!nc) break;
+                u32 nlba = (u32)(g_data_lba + (u32)(nc - 2) * g_spc + (noff % clus_bytes) / 512);
+                if (nlba != lba + count) break;
+                count++;
+            }
+            if (ata_write_sectors(lba, count, (const u16 *)(buf + done)) < 0) return -1;
+            n = count * 512;
+        } else {
+            /* Partial sector: keep existing bytes, zero the rest */
+            u8 *p = (u8 *)g_sec0;
+            if (off - in < f->size) {
+                if (ata_read_sector(lba, g_sec0) < 0) return -1;
+            } else {
+                memset(p, 0, 512);
+            }
+            memcpy(p + in, buf + done, n);
+            if (ata_write_sector(lba, g_sec0) < 0) return -1;
+        }
+
+        done += n;
+        if (off + n > f->size) {
+            f->size  = off + n;
+            f->dirty = 1;
+        }
+    }
+    return (done == 0 && len > 0) ? -1 : (int)done;
+}
+
+/*
+ * Make sure the chain covers size bytes, allocating all missing clusters
+ * in one contiguous run when the disk has one (delayed allocation: the
+ * write-back cache calls this once per flush instead of growing the
+ * file a cluster at a time).  Returns 0, or -1 if the disk is full.
+ */
+int fat16_reserve(struct fat16_file *f, unsigned int size)
+{
+    u32 clus_bytes = (u32)g_spc * 512;
+    u32 want = (size + clus_bytes - 1) / clus_bytes;
+    u32 have = 0;
+
+    if (f->first_cluster >= 2) {
+        /* Walk to the tail; file_cluster stops on the last cluster */
+        file_cluster(f, 0xFFFFFFFFu);
+        have = f->cur_index + 1;
+    }
+    if (have >= want) return 0;
+
+    u32 n = want - have;
+    u16 first = fat_alloc_run(n);
+    if (first) {
+        if (have == 0) { f->first_cluster = first; f->dirty = 1; }
+        else if (fat_set(f->cur_cluster, first) < 0) return -1;
+        return 0;
+    }
+
+    /* No run that long: fall back to one cluster at a time */
+    while (n--) {
+        u16 c = fat_alloc();
+        if (c == 0) return -1;
+        if (f->first_cluster < 2) { f->first_cluster = c; f->dirty = 1; }
+        else if (fat_set(f->cur_cluster, c) < 0) return -1;
+        f->cur_cluster = c;
+        f->cur_index   = have++;
+    }
+    return 0;
+}
+
+/* Clusters needed to hold size bytes */
+unsigned int fat16_clusters(unsigned int size)
+{
+    u32 clus_bytes = (u32)g_spc * 512;
+    return (size + clus_bytes - 1) / clus_bytes;
+}
+
+/* Free data clusters on the volume */
+unsigned int fat16_free_clusters(void)
+{
+    return g_free_clusters;
+}
+
+/* Bytes the data area holds: no file can grow larger than this. */
+unsigned int fat16_max_size(void)
+{
+    return (g_max_cluster - 2) * (u32)g_spc * 512;
+}
+
+/* Free the whole chain and set the size to 0 (directory entry updated). */
+int fat16_truncate(struct fat16_file *f)
+{
+    if (f->first_cluster == 0 && f->size == 0) return 0;
+    free_cluster_chain(f->first_cluster);
+    f->first_cluster = 0;
+    f->size          = 0;
+    f->cur_cluster   = 0;
+    f->cur_index     = 0;
+    f->dirty         = 1;
+    return fat16_sync(f);
+}
+
+/* Write size and first cluster back to the directory entry if changed. */
+int fat16_sync(struct fat16_file *f)
+{
+    if (!f->dirty) return 0;
+    if (ata_read_sector(f->dirent_lba, g_sec1) < 0) return -1;
+
+    u8 *ent = (u8 *)g_sec1 + f->dirent_off;
+    wr16(ent + 26, f->first_cluster);
+    wr32(ent + 28, f->size);
+    if (ata_write_sector(f->dirent_lba, g_sec1) < 0) return -1;
+
+    f->dirty = 0;
+    return 0;
+}
+
 /* ============================================================
  * fat16_delete — delete a file or empty directory from the cwd.
  * Returns  0 on success,
@@ -673,7 +1024,7 @@ mkdir_scan_done:
     /* Write . and .. entries into first sector of the new cluster */
     u32 new_lba = (u32)(g_data_lba + (u32)(new_cluster - 2) * g_spc);
     u8 *p = (u8 *)g_sec0;
-    for (int i = 0; i < 512; i++) p[i] = 0;
+    memset(p, 0, 512);
 
     /* . entry: points to itself */
     for (int i = 0; i < 11; i++) p[i] = ' ';
@@ -694,7 +1045,7 @@ mkdir_scan_done:
     }
 
     /* Zero out remaining sectors in the cluster */
-    for (int i = 0; i < 512; i++) p[i] = 0;
+    memset(p, 0, 512);
     for (u8 si = 1; si < g_spc; si++) {
         if (ata_write_sector(new_lba + si, g_sec0) < 0) return -1;
     }
@@ -0,0 +1,34 @@
+#ifndef FAT16_H
+#define FAT16_H
+
+/*
+ * Open-file handle for streaming access (fat16_open / fat16_pread /
+ * fat16_pwrite / fat16_sync).  Records where the directory entry lives
+ * so size and first cluster can be updated in place on sync, and caches
+ * one (index, cluster) pair so sequential access walks the chain once.
+ */
+struct fat16_file {
+    unsigned short first_cluster;  /* 0 = empty file, no chain yet        */
+    unsigned int   size;           /* file size in bytes                  */
+    unsigned int   dirent_lba;     /* sector holding the directory entry  */
+    unsigned short dirent_off;     /* byte offset of the entry in sector  */
+    unsigned short cur_cluster;    /* cached cluster number ...           */
+    unsigned int   cur_index;      /* ... and its index in the chain      */
+    int            dirty;          /* size / first cluster need sync      */
+};
+
+#define FAT16_CREATE  1   /* create the file if it does not exist */
+
+int fat16_open(const char *path, int flags, struct fat16_file *f);
+int fat16_pread(struct fat16_file *f, unsigned int pos,
+                unsigned char *buf, unsigned int len);
+int fat16_pwrite(struct fat16_file *f, unsigned int pos,
+                 const unsigned char *buf, unsigned int len);
+int fat16_reserve(struct fat16_file *f, unsigned int size);
+int fat16_truncate(struct fat16_file *f);
+int fat16_sync(struct fat16_file *f);
+unsigned int fat16_clusters(unsigned int size);
+unsigned int fat16_free_clusters(void);
+unsigned int fat16_max_size(void);
+
+#endif /* FAT16_H */
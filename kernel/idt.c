@@ -3,8 +3,10 @@
  *
  * Sets up 256-entry IDT, remaps the 8259 PIC so that hardware IRQs
  * land at INT 32-47 (not 8-15 where they would collide with CPU exceptions),
- * installs gates for exceptions (0-31), IRQs (32-47) and syscall (128).
- * Also sets up a 6-entry GDT with ring-0/ring-3 segments and a TSS.
+ * installs gates for exceptions (0-31), IRQs (32-47), syscall (128) and
+ * the in-kernel reschedule vector (129).
+ * Also sets up a 6-entry GDT with ring-0/ring-3 segments and a TSS, and
+ * programs the SYSENTER MSRs when the CPU supports the fast syscall path.
  */
 
 /* ============================================================
@@ -55,6 +57,44 @@ static struct gdt_ptr   gdtp;
 static tss_t            tss;
 uint8_t                 tss_stack[4096];  /* kernel stack for ISR when coming from ring 3 */
 
+/* ============================================================
+ * SYSENTER / SYSEXIT
+ *
+ * SYSENTER derives every selector from MSR_SYSENTER_CS:
+ *   CS = 0x08, SS = 0x10 (CS+8), user CS = 0x1B (CS+16|3), user SS = 0x23 (CS+24|3)
+ * which is exactly the GDT layout above.  The kernel stack MSR has to
+ * follow tss.esp0, so tss_set_ring0_stack() rewrites it on every switch.
+ * ============================================================ */
+
+#define MSR_SYSENTER_CS   0x174
+#define MSR_SYSENTER_ESP  0x175
+#define MSR_SYSENTER_EIP  0x176
+
+extern void sysenter_entry(void);   /* isr.asm */
+
+static int sysenter_ok = 0;          /* CPUID.1:EDX.SEP and MSRs programmed */
+
+static inline void wrmsr(uint32_t msr, uint32_t lo)
+{
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"(lo), "d"(0));
+}
+
+static void sysenter_init(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if (!(edx & (1u << 11)))
+        return;                      /* no SEP: user code must stay on int 0x80 */
+    /* Family 6, model < 3, stepping < 3 sets SEP but has no SYSENTER */
+    if (((eax >> 8) & 0xF) == 6 && ((eax >> 4) & 0xF) < 3 && (eax & 0xF) < 3)
+        return;
+
+    wrmsr(MSR_SYSENTER_CS,  0x08);
+    wrmsr(MSR_SYSENTER_ESP, tss.esp0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+    sysenter_ok = 1;
+}
+
 static void gdt_set_entry(int i, uint32_t base, uint32_t limit,
                            uint8_t access, uint8_t gran)
 {
@@ -119,11 +159,16 @@ void gdt_init(void)
 
     /* Load Task Register */
     __asm__ volatile ("ltr %%ax" : : "a"((uint16_t)0x28));
+
+    sysenter_init();
 }
 
 void tss_set_ring0_stack(uint32_t esp)
 {
     tss.esp0 = esp;
+    /* SYSENTER does not use the TSS — keep its stack MSR in sync */
+    if (sysenter_ok)
+        wrmsr(MSR_SYSENTER_ESP, esp);
 }
 
 
@@ -210,8 +255,8 @@ void pit_init(void)
     outb(PIT_CMD, 0x36);                   /* channel 0, lo/hi byte, mode 3 (square wave) */
     outb(PIT_CH0, (uint8_t)(divisor & 0xFF));
     outb(PIT_CH0, (uint8_t)(divisor >> 8));
-    /* Unmask IRQ0 (PIT) and IRQ1 (PS/2 keyboard) in master PIC */
-    outb(PIC1_DATA, 0xFC);
+    /* Unmask IRQ0 (PIT), IRQ1 (PS/2 keyboard) and IRQ4 (COM1) in master PIC */
+    outb(PIC1_DATA, 0xEC);
 }
 
 /* ============================================================
@@ -238,6 +283,7 @@ extern void isr44(void); extern void isr45(void); extern void isr46(void);
 extern void isr47(void);
 
 extern void isr128(void);
+extern void isr129(void);
 
 /* ============================================================
  * Public init function
@@ -302,6 +348,9 @@ void idt_init(void)
     /* Syscall (int 0x80): DPL=3 so user-mode code can call it later */
     idt_set_gate(128, (unsigned int)isr128, 0xEE);
 
+    /* Kernel reschedule (int 0x81): DPL=0, user-mode int 0x81 raises #GP */
+    idt_set_gate(129, (unsigned int)isr129, 0x8E);
+
     idtp.limit = sizeof(idt) - 1;
     idtp.base  = (unsigned int)&idt;
     __asm__ volatile ("lidt %0" : : "m"(idtp));
@@ -1,4 +1,5 @@
-; isr.asm - ISR stubs for CPU exceptions, IRQs and syscall (int 0x80)
+; isr.asm - ISR stubs for CPU exceptions, IRQs and syscall (int 0x80),
+;           plus the SYSENTER fast-syscall entry point
 ;
 ; Two macro variants:
 ;   ISR_NOERR n  — exception that does NOT push an error code (we push 0)
@@ -87,6 +88,9 @@ ISR_NOERR 47   ; IRQ15 secondary ATA
 ; Syscall
 ISR_NOERR 128  ; int 0x80
 
+; In-kernel reschedule (sleep_on)
+ISR_NOERR 129  ; int 0x81
+
 ; --------------------------------------------------------------------------
 ; Common stub: saves full register state and calls the C handler.
 ;
@@ -116,6 +120,7 @@ isr_common:
     push es
     push fs
     push gs
+    cld                 ; user code may have left DF=1; rep movs/stos need DF=0
 
     mov ax, 0x10        ; reload kernel data segment selectors
     mov ds, ax
@@ -133,6 +138,7 @@ isr_common:
     jz   .no_switch
     mov  esp, eax       ; switch to new process's saved kernel stack frame
 .no_switch:
+isr_restore:            ; also entered from sysenter_entry after a switch
 
     pop gs
     pop fs
@@ -141,3 +147,63 @@ isr_common:
     popa
     add esp, 8          ; discard int_no and err_code
     iret
+
+; --------------------------------------------------------------------------
+; sysenter_entry — SYSENTER fast syscall (MSRs programmed by sysenter_init)
+;
+; User-side convention (see syscall_sysenter in bin/os.h):
+;   EAX = syscall number, EBX/ECX/EDX = args (as for int 0x80)
+;   EBP = user ESP,  ESI = user return EIP
+;
+; The CPU only loads CS/SS/ESP/EIP from the MSRs and clears IF.  We build
+; exactly the frame int 0x80 would leave (int_no = 0x80), so isr_handler,
+; the scheduler and the segfault path cannot tell the difference.  A
+; process switched away here is later resumed through the normal iret path.
+;
+; No switch → return with SYSEXIT (EDX = EIP, ECX = ESP; the user wrapper
+; treats ECX/EDX as clobbered).  Switch → fall into isr_common's iret path.
+; --------------------------------------------------------------------------
+global sysenter_entry
+sysenter_entry:
+    push dword 0x23     ; user SS
+    push ebp            ; user ESP
+    push dword 0x3200   ; EFLAGS: IF=1, IOPL=3 (same as exec_run)
+    push dword 0x1B     ; user CS
+    push esi            ; user EIP
+    push dword 0        ; err_code
+    push dword 0x80     ; int_no — dispatched like int 0x80
+    pusha
+    push ds
+    push es
+    push fs
+    push gs
+    cld
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    push esp
+    call isr_handler
+    add esp, 4
+
+    test eax, eax
+    jnz  .switch
+
+    pop gs
+    pop fs
+    pop es
+    pop ds
+    popa
+    add esp, 8          ; discard int_no and err_code
+    mov edx, [esp]      ; user EIP
+    mov ecx, [esp+12]   ; user ESP
+    add esp, 20         ; drop EIP, CS, EFLAGS, ESP, SS
+    sti                 ; takes effect after SYSEXIT — no window in ring 0
+    sysexit
+
+.switch:
+    mov esp, eax
+    jmp isr_restore
@@ -4,7 +4,8 @@
  * Video:     VGA text mode — direct writes to memory at 0xB8000.
  *            BIOS interrupts are unavailable in 32-bit protected mode.
  * Serial:    COM1 (0x3F8) mirrors all output; run QEMU with -serial stdio
- *            to read it directly in the terminal.
+ *            to read it directly in the terminal.  Interrupt-driven (IRQ4)
+ *            with RX/TX ring buffers.
  * Keyboard:  PS/2 polling via I/O ports 0x60 / 0x64.
  *            Scan code set 1, US QWERTY layout.
  * RTC:       IBM PC Real Time Clock via ports 0x70/0x71.
@@ -40,6 +41,9 @@
 #define KEY_LEFT  0x82
 #define KEY_RIGHT 0x83
 
+/* memcpy / memset / memmove (rep movs/stos, no FPU) — shared with bin/os.h */
+#include "memops.h"
+
 
 /* ============================================================
  * I/O port helpers
@@ -70,26 +74,113 @@ static inline void outw(unsigned short port, unsigned short val)
 }
 
 /* ============================================================
- * COM1 serial driver (16550 UART)
+ * Interrupt flag helpers
+ * ============================================================ */
+
+/* Disable interrupts; return the previous EFLAGS for irq_restore(). */
+static inline unsigned int irq_save(void)
+{
+    unsigned int flags;
+    __asm__ volatile ("pushf\n pop %0\n cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(unsigned int flags)
+{
+    __asm__ volatile ("push %0\n popf" : : "r"(flags) : "memory", "cc");
+}
+
+/* ============================================================
+ * COM1 serial driver (16550 UART, interrupt-driven)
+ *
+ * RX: IRQ4 drains the receive FIFO into serial_rx_buf, so input is never
+ *     lost while the CPU sits in hlt waiting for the next PIT tick.
+ * TX: serial_putchar() only queues into serial_tx_buf.  serial_tx_kick()
+ *     refills the 16-byte transmit FIFO whenever it is empty — called by
+ *     the writer and by IRQ4 on THR-empty — so a writer only stalls when
+ *     the whole TX ring is full.
+ * Before serial_enable_irq() (early boot) output is polled; after a
+ * panic serial_flush() drains the ring by polling since IRQs are off.
  * ============================================================ */
 
+#define UART_DATA  (COM1 + 0)
+#define UART_IER   (COM1 + 1)
+#define UART_IIR   (COM1 + 2)   /* read                              */
+#define UART_FCR   (COM1 + 2)   /* write                             */
+#define UART_LCR   (COM1 + 3)
+#define UART_MCR   (COM1 + 4)
+#define UART_LSR   (COM1 + 5)
+
+#define UART_IER_RDA   0x01     /* received data available           */
+#define UART_IER_THRE  0x02     /* transmit holding register empty   */
+#define UART_LSR_DR    0x01     /* data ready                        */
+#define UART_LSR_THRE  0x20     /* TX FIFO empty                     */
+#define UART_FIFO_SIZE 16
+
+/* RX ring: unsigned char indices wrap naturally at 256 (like kbd_buf). */
+#define SERIAL_RX_SIZE 256
+static char                   serial_rx_buf[SERIAL_RX_SIZE];
+static volatile unsigned char serial_rx_head = 0;   /* write index (IRQ4)        */
+static volatile unsigned char serial_rx_tail = 0;   /* read  index (kbd_getchar) */
+
+/* TX ring: power-of-two size, indices masked with SERIAL_TX_MASK. */
+#define SERIAL_TX_SIZE 4096
+#define SERIAL_TX_MASK (SERIAL_TX_SIZE - 1)
+static char                  serial_tx_buf[SERIAL_TX_SIZE];
+static volatile unsigned int serial_tx_head = 0;    /* write index (serial_putchar) */
+static volatile unsigned int serial_tx_tail = 0;    /* read  index (serial_tx_kick) */
+
+static int serial_irq_on = 0;   /* set by serial_enable_irq() */
+
 static void serial_init(void)
 {
-    outb(COM1 + 1, 0x00);  /* disable interrupts           */
-    outb(COM1 + 3, 0x80);  /* enable DLAB (baud rate mode) */
-    outb(COM1 + 0, 0x03);  /* baud divisor lo: 38400 baud  */
-    outb(COM1 + 1, 0x00);  /* baud divisor hi              */
-    outb(COM1 + 3, 0x03);  /* 8 bits, no parity, 1 stop    */
-    outb(COM1 + 2, 0xC7);  /* enable FIFO, clear, 14-byte threshold */
+    outb(UART_IER, 0x00);  /* disable interrupts           */
+    outb(UART_LCR, 0x80);  /* enable DLAB (baud rate mode) */
+    outb(UART_DATA, 0x03); /* baud divisor lo: 38400 baud  */
+    outb(UART_IER, 0x00);  /* baud divisor hi              */
+    outb(UART_LCR, 0x03);  /* 8 bits, no parity, 1 stop    */
+    outb(UART_FCR, 0xC7);  /* enable FIFO, clear, 14-byte threshold */
+    outb(UART_MCR, 0x0B);  /* DTR + RTS + OUT2 (routes UART IRQ to the PIC) */
+}
+
+/*
+ * Move queued bytes into the UART while its TX FIFO is empty, then
+ * arm the THR-empty interrupt only if bytes remain.
+ * Caller must have interrupts disabled.
+ */
+static void serial_tx_kick(void)
+{
+    if (inb(UART_LSR) & UART_LSR_THRE) {
+        for (int n = 0; n < UART_FIFO_SIZE && serial_tx_tail != serial_tx_head; n++) {
+            outb(UART_DATA, (unsigned char)serial_tx_buf[serial_tx_tail]);
+            serial_tx_tail = (serial_tx_tail + 1) & SERIAL_TX_MASK;
+        }
+    }
+    if (serial_irq_on)
+        outb(UART_IER, (serial_tx_tail != serial_tx_head)
+                       ? (UART_IER_RDA | UART_IER_THRE) : UART_IER_RDA);
 }
 
 static void serial_putchar(char c)
 {
-    while (!(inb(COM1 + 5) & 0x20))
-        ;
     if (c == '\n')
         serial_putchar('\r');
-    outb(COM1, (unsigned char)c);
+
+    if (!serial_irq_on) {
+        while (!(inb(UART_LSR) & UART_LSR_THRE))
+            ;
+        outb(UART_DATA, (unsigned char)c);
+        return;
+    }
+
+    unsigned int flags = irq_save();
+    /* Ring full: wait for the FIFO to empty and push a burst by hand */
+    while (((serial_tx_head + 1) & SERIAL_TX_MASK) == serial_tx_tail)
+        serial_tx_kick();
+    serial_tx_buf[serial_tx_head] = c;
+    serial_tx_head = (serial_tx_head + 1) & SERIAL_TX_MASK;
+    serial_tx_kick();
+    irq_restore(flags);
 }
 
 static void serial_print(const char *s)
@@ -98,6 +189,35 @@ static void serial_print(const char *s)
         serial_putchar(*s++);
 }
 
+/* Drain the TX ring by polling — used when IRQ4 will never fire again. */
+static void serial_flush(void)
+{
+    unsigned int flags = irq_save();
+    while (serial_tx_tail != serial_tx_head)
+        serial_tx_kick();
+    irq_restore(flags);
+}
+
+/* IRQ4: move received bytes into the RX ring and refill the TX FIFO. */
+static void serial_irq(void)
+{
+    while (inb(UART_LSR) & UART_LSR_DR) {
+        char c = (char)inb(UART_DATA);
+        unsigned char next = serial_rx_head + 1;
+        if (next != serial_rx_tail)       /* drop silently if buffer full */
+            serial_rx_buf[serial_rx_head++] = c;
+    }
+    serial_tx_kick();
+    (void)inb(UART_IIR);                  /* acknowledge THR-empty        */
+}
+
+/* Switch from polled to interrupt-driven operation (IRQ4 unmasked by pit_init). */
+static void serial_enable_irq(void)
+{
+    serial_irq_on = 1;
+    outb(UART_IER, UART_IER_RDA);
+}
+
 /* ============================================================
  * VGA text mode driver
  * ============================================================ */
@@ -396,14 +516,14 @@ static char kbd_decode(unsigned char sc)
 
 /*
  * Non-blocking: returns 0 immediately if no key is ready.
- * Checks COM1 first (automated tests inject keystrokes via serial),
- * then drains the keyboard ring buffer filled by the IRQ1 handler.
+ * Checks the COM1 RX ring first (automated tests inject keystrokes via
+ * serial), then drains the keyboard ring buffer; both are filled by IRQs.
  */
 static char kbd_getchar(void)
 {
-    /* COM1 serial: automated tests send keystrokes via -serial stdio */
-    if (inb(COM1 + 5) & 0x01) {
-        char c = (char)inb(COM1);
+    /* COM1 serial ring (IRQ4): automated tests send keystrokes via -serial stdio */
+    if (serial_rx_head != serial_rx_tail) {
+        char c = serial_rx_buf[serial_rx_tail++];
         return (c == '\r') ? '\n' : c;   /* normalise CR → LF */
     }
 
@@ -466,52 +586,77 @@ static int ata_wait_drq(void)
     return -1;
 }
 
+/* Disk read counters, reported by SYS_IOSTAT */
+static unsigned int g_ata_read_cmds;
+static unsigned int g_ata_read_sectors;
+
 /*
- * Read one 512-byte sector at LBA address into buf[256].
- * Returns 0 on success, -1 on error.
+ * Read count (1..255) consecutive 512-byte sectors starting at LBA into
+ * buf[256 * count] with a single READ SECTORS command; the drive raises
+ * DRQ once per sector.  Returns 0 on success, -1 on error.
  */
-int ata_read_sector(unsigned int lba, unsigned short *buf)
+int ata_read_sectors(unsigned int lba, unsigned int count, unsigned short *buf)
 {
+    if (count == 0 || count > 255) return -1;
     if (ata_wait_bsy() < 0) return -1;
 
     outb(ATA_DRIVE,    (unsigned char)(0xE0 | ((lba >> 24) & 0x0F)));
-    outb(ATA_SECT_CNT, 1);
+    outb(ATA_SECT_CNT, (unsigned char)count);
     outb(ATA_LBA_LO,   (unsigned char)(lba         & 0xFF));
     outb(ATA_LBA_MID,  (unsigned char)((lba >>  8) & 0xFF));
     outb(ATA_LBA_HI,   (unsigned char)((lba >> 16) & 0xFF));
     outb(ATA_CMD,      ATA_CMD_READ);
-
-    ata_delay();
-    if (ata_wait_drq() < 0) return -1;
-
-    for (int i = 0; i < 256; i++)
-        buf[i] = inw(ATA_DATA);
+    g_ata_read_cmds++;
+
+    for (unsigned int s = 0; s < count; s++) {
+        ata_delay();
+        if (ata_wait_drq() < 0) return -1;
+        for (int i = 0; i < 256; i++)
+            buf[i] = inw(ATA_DATA);
+        buf += 256;
+        g_ata_read_sectors++;
+    }
 
     return 0;
 }
 
 /*
- * Write one 512-byte sector from buf[256] to LBA address.
+ * Read one 512-byte sector at LBA address into buf[256].
  * Returns 0 on success, -1 on error.
  */
-int ata_write_sector(unsigned int lba, const unsigned short *buf)
+int ata_read_sector(unsigned int lba, unsigned short *buf)
+{
+    return ata_read_sectors(lba, 1, buf);
+}
+
+/*
+ * Write count (1..255) consecutive 512-byte sectors from buf[256 * count]
+ * starting at LBA with a single WRITE SECTORS command, then flush the
+ * drive's write cache once.  Returns 0 on success, -1 on error.
+ */
+int ata_write_sectors(unsigned int lba, unsigned int count, const unsigned short *buf)
 {
+    if (count == 0 || count > 255) return -1;
     if (ata_wait_bsy() < 0) return -1;
 
     outb(ATA_DRIVE,    (unsigned char)(0xE0 | ((lba >> 24) & 0x0F)));
-    outb(ATA_SECT_CNT, 1);
+    outb(ATA_SECT_CNT, (unsigned char)count);
     outb(ATA_LBA_LO,   (unsigned char)(lba         & 0xFF));
     outb(ATA_LBA_MID,  (unsigned char)((lba >>  8) & 0xFF));
     outb(ATA_LBA_HI,   (unsigned char)((lba >> 16) & 0xFF));
     outb(ATA_CMD,      ATA_CMD_WRITE);
 
-    ata_delay();
-    if (ata_wait_drq() < 0) return -1;
-
-    for (int i = 0; i < 256; i++)
-        outw(ATA_DATA, buf[i]);
+    for (unsigned int s = 0; s < count; s++) {
+        ata_delay();
+        if (ata_wait_drq() < 0) return -1;
+        for (int i = 0; i < 256; i++)
+            outw(ATA_DATA, buf[i]);
+        buf += 256;
+    }
 
     /* Flush drive write cache */
+    ata_delay();
+    if (ata_wait_bsy() < 0) return -1;
     outb(ATA_CMD, ATA_CMD_FLUSH);
     ata_delay();
     ata_wait_bsy();
@@ -519,6 +664,15 @@ int ata_write_sector(unsigned int lba, const unsigned short *buf)
     return 0;
 }
 
+/*
+ * Write one 512-byte sector from buf[256] to LBA address.
+ * Returns 0 on success, -1 on error.
+ */
+int ata_write_sector(unsigned int lba, const unsigned short *buf)
+{
+    return ata_write_sectors(lba, 1, buf);
+}
+
 /* ============================================================
  * Status bar (row 24)
  * ============================================================ */
@@ -612,13 +766,22 @@ static void panic_screen(const char *msg, struct registers *r);
  *   0  exit(code)
  *   1  write(fd, buf, len)  -> bytes written;  fd 1 = stdout
  *   2  read(fd, buf, len)   -> bytes read;     fd 0 = stdin (line-buffered)
- *   3  open(path, flags)    -> fd or -1;       flags: 0=read, 1=write
+ *   3  open(path, flags)    -> fd or -1;       flags: O_RDONLY/O_WRONLY/O_RDWR
+ *                                              | O_CREAT | O_TRUNC | O_APPEND
  *   4  close(fd)            -> 0 or -1
+ *  20  yield()              -> 0;  give up the CPU to the next runnable process
+ *  21  waitpid(pid, &status, options) -> reaped pid, 0 (WNOHANG), or -1
+ *  22  getpid()             -> pid;  does nothing else (null-syscall benchmark)
+ *  23  sysstat(buf, max)    -> per-syscall call counts and TSC cycles
+ *  24  lseek(fd, off, whence) -> new position or -1
+ *  25  iostat(buf)          -> disk read and readahead counters
+ *
+ * Dispatch goes through syscall_table[]; see syscall_dispatch().
  *
  * File descriptors:
- *   0  stdin  (PS/2 keyboard, line-buffered)
- *   1  stdout (VGA + serial)
- *   2+ FAT16 file (up to MAX_FILE_FDS open at once)
+ *   0  stdin  (PS/2 keyboard, line-buffered) unless dup2() put a file there
+ *   1  stdout (VGA + serial), likewise
+ *   2+ FAT16 file or pipe end (per-process table, up to FD_MAX - 2 open at once)
  * ============================================================ */
 
 #define SYS_EXIT    0
@@ -641,12 +804,66 @@ static void panic_screen(const char *msg, struct registers *r);
 #define SYS_MEMINFO 17   /* (meminfo_ptr)  → 0                         */
 #define SYS_SBRK    18   /* (n)            → old_break or -1           */
 #define SYS_SLEEP   19   /* (ms)           → 0                         */
+#define SYS_YIELD   20   /* ()             → 0                         */
+#define SYS_WAITPID 21   /* (pid, status_ptr, options) → pid/0/-1      */
+#define SYS_GETPID  22   /* ()             → pid of caller (null syscall) */
+#define SYS_SYSSTAT 23   /* (buf, max)     → entries copied            */
+#define SYS_LSEEK   24   /* (fd, off, whence) → new position or -1     */
+#define SYS_IOSTAT  25   /* (iostat_ptr)   → 0                         */
+#define SYS_MMAP    26   /* (fd, len, flags) → address or -1           */
+#define SYS_MUNMAP  27   /* (addr)         → 0/-1                      */
+#define SYS_PIPE    28   /* (fds_ptr)      → 0/-1; fds[0] read, fds[1] write end */
+#define SYS_DUP2    29   /* (oldfd, newfd) → newfd or -1               */
+#define SYS_SHMAT   30   /* (key, size, flags) → address or -1         */
+#define SYS_SHMDT   31   /* (addr)         → 0/-1                      */
+#define SYS_SEND    32   /* (pid, req, reply) → 0/-1, blocks for reply */
+#define SYS_RECEIVE 33   /* (msg)          → sender pid, blocks        */
+#define SYS_REPLY   34   /* (pid, msg)     → 0/-1                      */
+#define SYS_FORK    35   /* ()             → child pid / 0 in child / -1 */
+#define SYS_THREAD  36   /* (fn, arg, start) → tid or -1               */
+#define SYS_JOIN    37   /* (tid, status)  → tid or -1, blocks         */
+#define SYS_FUTEX_WAIT 38 /* (addr, val)   → 0, or -1 if *addr != val  */
+#define SYS_FUTEX_WAKE 39 /* (addr, n)     → threads woken             */
+#define SYS_PAGEOUT 40   /* (addr, len)    → pages swapped out, or -1  */
+#define SYS_SETLIMIT 41  /* (which, kb)    → previous limit in kB, or -1 */
+#define SYS_PROCINFO 42  /* (buf, max)     → entries filled, or -1     */
+#define NR_SYSCALLS 43
+
+#define WNOHANG     1    /* waitpid option: return 0 instead of blocking */
+
+#define LIMIT_RSS   0    /* setlimit: resident user memory             */
+#define LIMIT_HEAP  1    /* setlimit: heap size (sbrk)                 */
 
 /* PIT tick frequency — must match divisor in pit_init() in idt.c */
 #define PIT_HZ      100
 
 static unsigned int g_ticks = 0;   /* incremented by IRQ0 (PIT) every 10 ms */
 
+/* Per-syscall statistics, indexed by syscall number (SYS_SYSSTAT) */
+struct sysstat_entry {
+    unsigned int       count;    /* invocations                         */
+    unsigned long long cycles;   /* total TSC cycles spent in the handler */
+};
+
+static struct sysstat_entry g_sc_stats[NR_SYSCALLS];
+
+static inline unsigned long long rdtsc(void)
+{
+    unsigned long long t;
+    __asm__ volatile ("rdtsc" : "=A"(t));
+    return t;
+}
+
+/* Copy up to max entries of g_sc_stats to buf; returns entries copied. */
+static int sys_sysstat(struct sysstat_entry *buf, int max)
+{
+    int n = max < NR_SYSCALLS ? max : NR_SYSCALLS;
+    if (n < 0) return -1;
+    for (int i = 0; i < n; i++)
+        buf[i] = g_sc_stats[i];
+    return n;
+}
+
 struct meminfo {
     unsigned int phys_total_kb;
     unsigned int phys_used_kb;
@@ -655,186 +872,1045 @@ struct meminfo {
     unsigned int virt_used_kb;
     unsigned int virt_free_kb;
     int          n_procs;
+    unsigned int swap_total_kb;   /* 0 = no swap file */
+    unsigned int swap_used_kb;
+};
+
+/* One process as SYS_PROCINFO reports it; its threads are counted in it */
+struct procinfo {
+    int          pid;
+    int          parent_pid;
+    int          threads;         /* besides the main one                    */
+    unsigned int rss_kb;          /* resident user pages × 4                 */
+    unsigned int swap_kb;         /* pages in swap × 4                       */
+    unsigned int heap_kb;         /* sbrk() total                            */
+    unsigned int rss_limit_kb;    /* 0 = no limit                            */
+    unsigned int heap_limit_kb;   /* 0 = no limit                            */
+    char         state;           /* R run, S sleep, W wait for exec, Z zombie */
+    char         name[16];
 };
 
 struct direntry { char name[13]; unsigned int size; int is_dir; };
 
+/* ============================================================
+ * PMM — physical memory manager
+ * ============================================================ */
+#include "pmm.h"
+
 #define FD_STDIN   0
 #define FD_STDOUT  1
 #define FD_FILE0   2
 
 #define O_RDONLY   0
 #define O_WRONLY   1
+#define O_RDWR     2
+#define O_ACCMODE  3
+#define O_CREAT    0x40    /* create the file if it does not exist     */
+#define O_TRUNC    0x200   /* discard existing contents (needs write)  */
+#define O_APPEND   0x400   /* every write goes to the current end      */
+
+#define SEEK_SET   0
+#define SEEK_CUR   1
+#define SEEK_END   2
+
+#define FD_INLINE       16     /* fd slots embedded in every process      */
+#define FD_MAX          1024   /* grown table: one frame of file pointers */
+
+#define PC_PAGE_SIZE    4096
+#define PC_PAGES        64     /* page cache: up to 64 kernel frames (256 KB) */
+#define FNODE_MAX       64     /* distinct files open or cached at once       */
+#define RA_INIT         1      /* readahead pages on the first sequential miss */
+#define RA_MAX          4
+#define WB_INTERVAL     PIT_HZ /* flusher wakes once a second ...             */
+#define WB_AGE          PIT_HZ /* ... and writes pages dirty for at least 1 s */
+#define PIPE_SIZE       4096   /* pipe ring buffer: one kernel frame          */
+#define PIPE_MAX        16
+
+#include "fat16.h"
+
+/*
+ * File page cache and write-back
+ *
+ * Every open file is backed by an fnode, shared by all opens of the same
+ * directory entry, which owns the on-disk handle (chain, size) and the
+ * file's logical size.  File data moves through g_pages, 4 KB pages keyed
+ * by (fnode, page index).  read() fills missing pages from disk, except
+ * that whole pages not in the cache are read straight into the caller's
+ * buffer (one PIO transfer, no copy, no cache pollution).  write() only
+ * dirties pages, so nothing touches the disk or the FAT on the write
+ * path and close() just drops a reference.
+ *
+ * Dirty pages are written back per fnode: the missing clusters for the
+ * whole logical size are allocated in one contiguous run first (delayed
+ * allocation), then the pages go out in file order.  This happens
+ *   - every WB_INTERVAL for pages dirty longer than WB_AGE: IRQ0 only
+ *     sets g_wb_due, wb_run does the flush on the way out of the next
+ *     syscall or from an idle hlt loop, never inside an interrupt,
+ *   - when the cache is full of dirty pages and a new one is needed,
+ *   - before anything reads the directory or the disk directly
+ *     (readdir, exec) via wb_flush_all.
+ */
+struct fnode {
+    int               refs;    /* struct files using it; 0 = cached only */
+    int               used;
+    struct fat16_file f;       /* on-disk state: chain, size, dirent     */
+    unsigned int      size;    /* logical size, including dirty pages    */
+};
+
+struct cpage {
+    struct fnode  *fn;         /* 0 = slot free                          */
+    unsigned int   index;      /* file offset / PC_PAGE_SIZE             */
+    unsigned char *data;       /* kernel frame, kept when the slot is freed */
+    unsigned int   dirty_lo;   /* dirty bytes in the page; lo == hi: clean */
+    unsigned int   dirty_hi;
+    unsigned int   dirty_tick; /* g_ticks when the page became dirty     */
+    unsigned int   last_use;   /* g_pc_clock at the last access (LRU)    */
+    int            ra;         /* read ahead and not used yet            */
+    int            mapped;     /* MAP_SHARED PTEs using data; pinned while > 0 */
+};
+
+static struct fnode g_fnodes[FNODE_MAX];
+static struct cpage g_pages[PC_PAGES];
+static unsigned int g_pc_clock;
+
+/*
+ * Pipes
+ *
+ * A pipe is a PIPE_SIZE ring buffer with two ends, each a struct file
+ * (O_RDONLY / O_WRONLY) pointing at it, so pipe fds are closed, inherited
+ * and dup2()ed like any other.  Readers sleep on &rd while the buffer is
+ * empty, writers on &wr while it is full; each side wakes the other after
+ * moving data.  read() returns 0 once the buffer is empty and the last
+ * write end is gone; write() fails once the last read end is gone.
+ */
+struct pipe {
+    unsigned char *data;       /* kernel frame; 0 = slot free            */
+    unsigned int   rd;         /* bytes read so far (free-running)       */
+    unsigned int   wr;         /* bytes written so far; wr - rd buffered */
+    int            readers;    /* open read-end struct files             */
+    int            writers;    /* open write-end struct files            */
+};
 
-#define MAX_FILE_FDS  4
-#define FILE_BUF_SIZE 16384   /* 16 KB per file descriptor */
+static struct pipe g_pipes[PIPE_MAX];
 
-struct fd_entry {
-    int           used;
+/*
+ * An open file: a position on an fnode plus the readahead state.
+ * ra_pages doubles on every miss at ra_next (where a sequential reader
+ * goes next) and drops to 0 on a random access.  Shared by every fd slot
+ * that refers to it (refs).
+ */
+struct file {
+    int           refs;
     int           mode;
-    unsigned int  size;
     unsigned int  pos;
-    char          name[128];
-    unsigned char buf[FILE_BUF_SIZE];
+    struct fnode *fn;         /* 0 for a pipe end */
+    struct pipe  *pipe;       /* 0 for a regular file */
+    unsigned int  ra_next;    /* page index following the last one read */
+    unsigned int  ra_pages;   /* readahead for the next sequential miss */
+    struct file  *next_free;
 };
 
-static struct fd_entry g_fds[MAX_FILE_FDS];
+static struct file *g_file_free;   /* slab of struct files carved from frames */
+
+/* Readahead counters, in pages (SYS_IOSTAT) */
+static unsigned int g_ra_prefetched;   /* read ahead of demand            */
+static unsigned int g_ra_hits;         /* ... and later used              */
+static unsigned int g_ra_waste;        /* ... and dropped without a use   */
+
+/* Pages read from disk straight into a user buffer, bypassing the cache */
+static unsigned int g_rd_direct;
+
+/* Write-back counters (SYS_IOSTAT) */
+static unsigned int g_wb_pages;        /* dirty pages written to disk     */
+static unsigned int g_wb_flushes;      /* files flushed                   */
+
+/*
+ * Per-process fd table, indexed by fd.  Slots 0 and 1 (stdin/stdout)
+ * are empty — the console — unless dup2() put a file there; open() and
+ * pipe() only hand out 2 and up.  Starts on the FD_INLINE slots inside
+ * the PCB and moves to a frame of FD_MAX pointers when those run out.
+ */
+struct fd_table {
+    struct file **fd;
+    unsigned int  cap;
+    struct file  *fd_inline[FD_INLINE];
+};
 
 extern int fat16_read(const char *filename, unsigned char *buf, unsigned int max_bytes);
 extern int fat16_write(const char *filename, const unsigned char *data, unsigned int size);
 extern int fat16_read_from_bin(const char *name, unsigned char *buf, unsigned int max_bytes);
+extern int fat16_delete(const char *name);
 
-static int sys_write(unsigned int fd, const char *buf, unsigned int len)
+static struct cpage *pc_find(struct fnode *fn, unsigned int idx)
 {
-    unsigned int i;
-    if (fd == FD_STDOUT) {
-        for (i = 0; i < len; i++)
-            vga_putchar(buf[i], COLOR_DEFAULT);
-        return (int)len;
-    }
-    if (fd >= FD_FILE0 && fd < (unsigned int)(FD_FILE0 + MAX_FILE_FDS)) {
-        struct fd_entry *f = &g_fds[fd - FD_FILE0];
-        if (!f->used || f->mode != O_WRONLY) return -1;
-        for (i = 0; i < len; i++) {
-            if (f->pos >= FILE_BUF_SIZE) return (int)i;
-            f->buf[f->pos++] = (unsigned char)buf[i];
-        }
-        if (f->pos > f->size) f->size = f->pos;
-        return (int)len;
+    for (int i = 0; i < PC_PAGES; i++)
+        if (g_pages[i].fn == fn && g_pages[i].index == idx) return &g_pages[i];
+    return 0;
+}
+
+/* Free a page slot; a prefetched page that was never used counts as waste. */
+static void pc_release(struct cpage *p)
+{
+    if (p->ra) g_ra_waste++;
+    p->fn = 0;
+    p->ra = 0;
+    p->dirty_lo = p->dirty_hi = 0;
+}
+
+/*
+ * Give the frame of the least recently used clean, unmapped cached page
+ * back to the PMM: reclaim with no disk I/O.  The page used last is kept,
+ * as the syscall that faulted may be copying from or into it.
+ * 0 = a frame was freed.
+ */
+static int pc_shrink(void)
+{
+    struct cpage *victim = 0;
+    for (int i = 0; i < PC_PAGES; i++) {
+        struct cpage *p = &g_pages[i];
+        if (!p->fn || p->mapped || p->dirty_lo != p->dirty_hi || p->last_use == g_pc_clock)
+            continue;
+        if (!victim || p->last_use < victim->last_use) victim = p;
     }
-    return -1;
+    if (!victim) return -1;
+    pc_release(victim);
+    pmm_free((unsigned int)victim->data);
+    victim->data = 0;                       /* pc_alloc gets a new one */
+    return 0;
 }
 
-static int sys_read(unsigned int fd, char *buf, unsigned int len)
+/* 1 if some page of fn is mapped into a process (it must stay in place). */
+static int pc_mapped(struct fnode *fn)
 {
-    if (fd == FD_STDIN) {
-        unsigned int i = 0;
-        /* Enable interrupts so background processes can run while we wait. */
-        __asm__ volatile("sti");
-        while (i < len) {
-            char c = 0;
-            while (!c) {
-                __asm__ volatile("hlt");
-                c = kbd_getchar();
+    for (int i = 0; i < PC_PAGES; i++)
+        if (g_pages[i].fn == fn && g_pages[i].mapped) return 1;
+    return 0;
+}
+
+/* Forget every cached page of fn, discarding dirty data (truncate, unlink). */
+static void pc_drop(struct fnode *fn)
+{
+    for (int i = 0; i < PC_PAGES; i++)
+        if (g_pages[i].fn == fn) pc_release(&g_pages[i]);
+}
+
+/*
+ * Write back all dirty pages of fn: allocate clusters for its whole size
+ * in one go, write the pages in file order, then update the directory
+ * entry.  Returns 0, or -1 on I/O error / disk full (pages stay dirty).
+ */
+static int wb_flush_fnode(struct fnode *fn)
+{
+    int dirty = 0;
+    for (int i = 0; i < PC_PAGES; i++)
+        if (g_pages[i].fn == fn && g_pages[i].dirty_lo != g_pages[i].dirty_hi) dirty = 1;
+
+    if (dirty) {
+        if (fat16_reserve(&fn->f, fn->size) < 0) return -1;
+        for (;;) {
+            struct cpage *lo = 0;
+            for (int i = 0; i < PC_PAGES; i++) {
+                struct cpage *p = &g_pages[i];
+                if (p->fn == fn && p->dirty_lo != p->dirty_hi &&
+                    (!lo || p->index < lo->index))
+                    lo = p;
             }
-            buf[i++] = c;
-            vga_putchar(c, COLOR_DEFAULT);
-            serial_putchar(c);
-            if (c == '\n') break;
+            if (!lo) break;
+            unsigned int n = lo->dirty_hi - lo->dirty_lo;
+            if (fat16_pwrite(&fn->f, lo->index * PC_PAGE_SIZE + lo->dirty_lo,
+                             lo->data + lo->dirty_lo, n) != (int)n)
+                return -1;
+            lo->dirty_lo = lo->dirty_hi = 0;
+            g_wb_pages++;
         }
-        __asm__ volatile("cli");
-        return (int)i;
-    }
-    if (fd >= FD_FILE0 && fd < (unsigned int)(FD_FILE0 + MAX_FILE_FDS)) {
-        struct fd_entry *f = &g_fds[fd - FD_FILE0];
-        if (!f->used || f->mode != O_RDONLY) return -1;
-        unsigned int i;
-        for (i = 0; i < len && f->pos < f->size; i++)
-            buf[i] = (char)f->buf[f->pos++];
-        return (int)i;
+        g_wb_flushes++;
     }
-    return -1;
+    return fat16_sync(&fn->f);
 }
 
-static int sys_open(const char *path, int flags)
+/*
+ * Clusters that write-back still has to allocate: file growth that is
+ * only in the page cache so far.  write() refuses to grow a file past
+ * what the free clusters can cover, so a flush never runs out of disk.
+ */
+static unsigned int wb_unallocated(void)
 {
-    int i;
-    for (i = 0; i < MAX_FILE_FDS; i++) {
-        if (!g_fds[i].used) break;
+    unsigned int n = 0;
+    for (int i = 0; i < FNODE_MAX; i++) {
+        struct fnode *fn = &g_fnodes[i];
+        if (fn->used && fn->size > fn->f.size)
+            n += fat16_clusters(fn->size) - fat16_clusters(fn->f.size);
     }
-    if (i == MAX_FILE_FDS) return -1;
+    return n;
+}
+
+static void wb_flush_all(void)
+{
+    for (int i = 0; i < FNODE_MAX; i++)
+        if (g_fnodes[i].used) wb_flush_fnode(&g_fnodes[i]);
+}
 
-    struct fd_entry *f = &g_fds[i];
+/* Set by IRQ0 every WB_INTERVAL; cleared by wb_run. */
+static volatile int g_wb_due;
 
-    int plen = 0;
-    while (path[plen]) plen++;
-    if (plen > 127) return -1;
+/*
+ * Flush files with pages dirty for WB_AGE.  Interrupts must be off and no
+ * FAT or ATA operation in flight: called at syscall exit and from idle_hlt.
+ */
+static void wb_run(void)
+{
+    g_wb_due = 0;
+    for (int i = 0; i < PC_PAGES; i++) {
+        struct cpage *p = &g_pages[i];
+        if (p->fn && p->dirty_lo != p->dirty_hi && g_ticks - p->dirty_tick >= WB_AGE)
+            wb_flush_fnode(p->fn);
+    }
+}
 
-    int j;
-    for (j = 0; j < 127 && path[j]; j++) f->name[j] = path[j];
-    f->name[j] = '\0';
+/* hlt with interrupts enabled; runs a due write-back while we are idle anyway. */
+static void idle_hlt(void)
+{
+    __asm__ volatile("hlt");
+    if (g_wb_due) {
+        __asm__ volatile("cli");
+        wb_run();
+        __asm__ volatile("sti");
+    }
+}
 
-    f->mode = flags;
-    f->pos  = 0;
+/*
+ * Get a free page slot with a frame: an unused slot, else the least
+ * recently used clean page.  If every page is dirty, the file owning the
+ * oldest one is written back first; if that fails (I/O error), the file
+ * with the next oldest page, up to 8 files.  Returns 0 if nothing can be
+ * freed.
+ */
+static struct cpage *pc_alloc(void)
+{
+    struct fnode *failed[8];
+    int nfailed = 0;
+    for (;;) {
+        struct cpage *victim = 0, *oldest = 0;
+        for (int i = 0; i < PC_PAGES; i++) {
+            struct cpage *p = &g_pages[i];
+            if (!p->fn) {
+                if (!p->data && !(p->data = (unsigned char *)pmm_alloc_kernel())) continue;
+                return p;
+            }
+            if (p->mapped) continue;
+            if (p->dirty_lo == p->dirty_hi) {
+                if (!victim || p->last_use < victim->last_use) victim = p;
+                continue;
+            }
+            int j = 0;
+            while (j < nfailed && failed[j] != p->fn) j++;
+            if (j == nfailed && (!oldest || p->dirty_tick < oldest->dirty_tick))
+                oldest = p;
+        }
+        if (!victim) {
+            if (!oldest || nfailed == 8) return 0;
+            if (wb_flush_fnode(oldest->fn) < 0) { failed[nfailed++] = oldest->fn; continue; }
+            victim = oldest;
+        }
+        pc_release(victim);
+        return victim;
+    }
+}
 
-    if (flags == O_RDONLY) {
-        int n = fat16_read(path, f->buf, FILE_BUF_SIZE);
-        if (n < 0) return -1;
-        f->size = (unsigned int)n;
+/*
+ * Return page idx of fn, reading it from disk (fill) or zeroing it if it
+ * is not cached.  Bytes past the on-disk size always read as zero.
+ */
+static struct cpage *pc_get(struct fnode *fn, unsigned int idx, int fill)
+{
+    struct cpage *p = pc_find(fn, idx);
+    if (p) {
+        if (p->ra) { p->ra = 0; g_ra_hits++; }
     } else {
-        f->size = 0;
+        p = pc_alloc();
+        if (!p) return 0;
+        unsigned int n = 0;
+        if (fill) {
+            int r = fat16_pread(&fn->f, idx * PC_PAGE_SIZE, p->data, PC_PAGE_SIZE);
+            if (r < 0) return 0;
+            n = (unsigned int)r;
+        }
+        memset(p->data + n, 0, PC_PAGE_SIZE - n);
+        p->fn    = fn;
+        p->index = idx;
+    }
+    p->last_use = ++g_pc_clock;
+    return p;
+}
+
+/* Look up the fnode for a directory entry, or set one up from h. */
+static struct fnode *fnode_get(const struct fat16_file *h)
+{
+    struct fnode *fn = 0;
+    for (int i = 0; i < FNODE_MAX; i++) {
+        struct fnode *c = &g_fnodes[i];
+        if (c->used && c->f.dirent_lba == h->dirent_lba && c->f.dirent_off == h->dirent_off)
+            return c;
+        if (!c->used && !fn) fn = c;
+    }
+    /* Table full: recycle a cached-only fnode whose pages can be written back */
+    for (int i = 0; !fn && i < FNODE_MAX; i++) {
+        struct fnode *c = &g_fnodes[i];
+        if (c->refs == 0 && wb_flush_fnode(c) == 0) {
+            pc_drop(c);
+            fn = c;
+        }
     }
+    if (!fn) return 0;
+    fn->used = 1;
+    fn->refs = 0;
+    fn->f    = *h;
+    fn->size = h->size;
+    return fn;
+}
 
-    f->used = 1;
-    return i + FD_FILE0;
+static struct file *file_alloc(void)
+{
+    if (!g_file_free) {
+        struct file *slab = (struct file *)pmm_alloc_kernel();
+        if (!slab) return 0;
+        for (unsigned int i = 0; i < PC_PAGE_SIZE / sizeof(struct file); i++) {
+            slab[i].next_free = g_file_free;
+            g_file_free = &slab[i];
+        }
+    }
+    struct file *f = g_file_free;
+    g_file_free = f->next_free;
+    return f;
 }
 
-static int sys_close(unsigned int fd)
+static void fd_table_init(struct fd_table *t)
 {
-    if (fd < FD_FILE0 || fd >= (unsigned int)(FD_FILE0 + MAX_FILE_FDS)) return -1;
-    struct fd_entry *f = &g_fds[fd - FD_FILE0];
-    if (!f->used) return -1;
+    t->fd  = t->fd_inline;
+    t->cap = FD_INLINE;
+    for (int i = 0; i < FD_INLINE; i++) t->fd_inline[i] = 0;
+}
 
-    if (f->mode == O_WRONLY)
-        fat16_write(f->name, f->buf, f->size);
+/* Return the open file behind fd, or 0 if fd is not an open file. */
+static struct file *fd_get(struct fd_table *t, unsigned int fd)
+{
+    if (fd >= t->cap) return 0;
+    return t->fd[fd];
+}
 
-    f->used = 0;
+/* Move t from the inline slots to a frame of FD_MAX.  -1 if already there or out of memory. */
+static int fd_grow(struct fd_table *t)
+{
+    if (t->cap >= FD_MAX) return -1;
+    struct file **big = (struct file **)pmm_alloc_kernel();
+    if (!big) return -1;
+    for (unsigned int j = 0; j < FD_MAX; j++)
+        big[j] = j < t->cap ? t->fd[j] : 0;
+    t->fd  = big;
+    t->cap = FD_MAX;
     return 0;
 }
 
-extern unsigned int exec_ret_esp;  /* defined in entry.asm; used by SYS_EXIT */
-static unsigned int g_exit_code;   /* set by SYS_EXIT, returned by SYS_EXEC */
+/* Reserve the lowest free fd for f, growing the table if needed.  -1 if full. */
+static int fd_install(struct fd_table *t, struct file *f)
+{
+    unsigned int i;
+    for (i = FD_FILE0; i < t->cap; i++)
+        if (!t->fd[i]) break;
 
-extern void tss_set_ring0_stack(unsigned int esp0);
+    if (i == t->cap && fd_grow(t) < 0) return -1;
+    t->fd[i] = f;
+    return (int)i;
+}
 
-/* ============================================================
- * Forward declarations needed by syscall_dispatch
- * ============================================================ */
+/*
+ * Share the parent's fds 0..n-1 with a new process: exec passes stdin and
+ * stdout only (other fds stay private), fork the whole table.  -1 if the
+ * child's table cannot grow to n.
+ */
+static int fd_inherit(struct fd_table *child, struct fd_table *parent, unsigned int n)
+{
+    if (n > child->cap && fd_grow(child) < 0) return -1;
+    for (unsigned int i = 0; i < n; i++) {
+        child->fd[i] = parent->fd[i];
+        if (child->fd[i]) child->fd[i]->refs++;
+    }
+    return 0;
+}
 
-/* Program loader constants */
-#define PROG_BASE      0x400000
-#define PROG_MAX_SIZE  (256 * 1024)
-#define ARGS_BASE      0x7FC000
-#define ARGS_MAX       200
-#define USER_STACK_TOP 0x7FF000
-#define HEAP_BASE      0x440000   /* first heap page (VPN 64, right after binary) */
-#define HEAP_MAX       0x7F8000   /* heap limit: VPN 1015, stays clear of stack   */
-#define PAGE_SIZE      4096
+/* Prefetch up to ra_pages pages after a miss on page idx. */
+static void file_readahead(struct file *f, unsigned int idx)
+{
+    struct fnode *fn = f->fn;
+    if (idx == f->ra_next)
+        f->ra_pages = f->ra_pages ? f->ra_pages * 2 : RA_INIT;
+    else
+        f->ra_pages = 0;
+    if (f->ra_pages > RA_MAX) f->ra_pages = RA_MAX;
+
+    unsigned int last = (fn->size - 1) / PC_PAGE_SIZE;
+    for (unsigned int j = idx + 1; j <= idx + f->ra_pages && j <= last; j++) {
+        if (pc_find(fn, j)) continue;
+        struct cpage *p = pc_get(fn, j, 1);
+        if (!p) break;
+        p->ra = 1;
+        g_ra_prefetched++;
+    }
+}
 
-extern void         exec_run(unsigned int entry, unsigned int user_stack_top,
-                              unsigned int kstack_top);
-extern int            fat16_listdir(void (*cb)(const char *name, unsigned int size, int is_dir));
-extern int            fat16_delete(const char *name);
-extern int            fat16_mkdir(const char *name);
-extern int            fat16_rename(const char *src, const char *dst);
-extern int            fat16_chdir(const char *name);
-extern unsigned short fat16_get_cwd_cluster(void);
-extern void           fat16_set_cwd_cluster(unsigned short c);
+/*
+ * Bytes from page-aligned pos, at most max, that can bypass the cache:
+ * a run of uncached pages, each taken whole (or up to the end of the
+ * file) and already on disk.  0 if the page at pos does not qualify.
+ */
+static unsigned int file_direct_len(struct fnode *fn, unsigned int pos, unsigned int max)
+{
+    unsigned int d = 0;
+    while (pos + d < fn->size && !pc_find(fn, (pos + d) / PC_PAGE_SIZE)) {
+        unsigned int n = fn->size - (pos + d);
+        if (n > PC_PAGE_SIZE) n = PC_PAGE_SIZE;
+        if (pos + d + n > fn->f.size || d + n > max) break;
+        d += n;
+    }
+    return d;
+}
 
-/* ============================================================
- * Paging data structures
- * ============================================================ */
+static int user_prefault(unsigned int addr, unsigned int len, int write);
+static int g_user_io;   /* a direct read's PIO transfer into user memory is in flight */
+static void sleep_on(void *chan);
+static void wakeup(void *chan);
 
-static unsigned int page_dir[1024]   __attribute__((aligned(4096)));
-static unsigned int pt_kernel[1024]  __attribute__((aligned(4096)));  /* 0–4 MB */
+#define FILE_READABLE(f)  (((f)->mode & O_ACCMODE) != O_WRONLY)
+#define FILE_WRITABLE(f)  (((f)->mode & O_ACCMODE) != O_RDONLY)
 
-/* ============================================================
- * PMM — physical memory manager
- * ============================================================ */
-#include "pmm.h"
+/* Close one end of p; the other side may be waiting for exactly that. */
+static void pipe_put(struct pipe *p, int mode)
+{
+    if (mode == O_WRONLY) { p->writers--; wakeup(&p->rd); }
+    else                  { p->readers--; wakeup(&p->wr); }
+    if (!p->readers && !p->writers) {
+        pmm_free((unsigned int)p->data);
+        p->data = 0;
+    }
+}
 
-/* ============================================================
- * Process Control Block
- * ============================================================ */
+/* Drop one reference; the last one returns f to the slab.  Dirty pages stay cached. */
+static void file_put(struct file *f)
+{
+    if (--f->refs > 0) return;
+    if (f->pipe) pipe_put(f->pipe, f->mode & O_ACCMODE);
+    else         f->fn->refs--;
+    f->next_free = g_file_free;
+    g_file_free  = f;
+}
 
-#define PROC_MAX_PROCS  32
-#define PROC_MAX_FRAMES  2   /* phys_frames[0]=PD, phys_frames[1]=PT; user pages freed via PT scan */
+/* Close every fd in t and return a grown table's frame to the PMM. */
+static void fd_table_release(struct fd_table *t)
+{
+    for (unsigned int i = 0; i < t->cap; i++)
+        if (t->fd[i]) file_put(t->fd[i]);
+    if (t->fd != t->fd_inline)
+        pmm_free((unsigned int)t->fd);
+    fd_table_init(t);
+}
 
-typedef enum { PROC_UNUSED=0, PROC_RUNNING, PROC_READY, PROC_ZOMBIE,
-               PROC_SLEEPING, PROC_WAITING } proc_state_t;
+/* Copy n bytes out of / into the ring at the free-running offset off. */
+static void pipe_copy_out(struct pipe *p, unsigned int off, char *buf, unsigned int n)
+{
+    unsigned int at = off % PIPE_SIZE, c = PIPE_SIZE - at;
+    if (c > n) c = n;
+    memcpy(buf, p->data + at, c);
+    memcpy(buf + c, p->data, n - c);
+}
+
+static void pipe_copy_in(struct pipe *p, unsigned int off, const char *buf, unsigned int n)
+{
+    unsigned int at = off % PIPE_SIZE, c = PIPE_SIZE - at;
+    if (c > n) c = n;
+    memcpy(p->data + at, buf, c);
+    memcpy(p->data, buf + c, n - c);
+}
+
+/* Whatever is buffered, up to len; blocks only while the pipe is empty. */
+static int pipe_read(struct pipe *p, char *buf, unsigned int len)
+{
+    if (!len) return 0;
+    while (p->wr == p->rd) {
+        if (!p->writers) return 0;   /* EOF */
+        sleep_on(&p->rd);
+    }
+    unsigned int n = p->wr - p->rd;
+    if (n > len) n = len;
+    pipe_copy_out(p, p->rd, buf, n);
+    p->rd += n;
+    wakeup(&p->wr);
+    return (int)n;
+}
+
+/* All len bytes, blocking while the pipe is full; -1 if nobody can read them. */
+static int pipe_write(struct pipe *p, const char *buf, unsigned int len)
+{
+    unsigned int i = 0;
+    while (i < len) {
+        if (!p->readers) return i ? (int)i : -1;
+        unsigned int n = PIPE_SIZE - (p->wr - p->rd);
+        if (!n) { sleep_on(&p->wr); continue; }
+        if (n > len - i) n = len - i;
+        pipe_copy_in(p, p->wr, buf + i, n);
+        p->wr += n;
+        i     += n;
+        wakeup(&p->rd);
+    }
+    return (int)len;
+}
+
+/* Largest file position: what the volume can hold, and what lseek() can return. */
+static unsigned int file_max_size(void)
+{
+    unsigned int max = fat16_max_size();
+    return max < 0x7FFFFFFFu ? max : 0x7FFFFFFFu;
+}
+
+static int sys_write(struct fd_table *t, unsigned int fd, const char *buf, unsigned int len)
+{
+    unsigned int i;
+    if (user_prefault((unsigned int)buf, len, 0) < 0) return -1;
+    if (fd == FD_STDOUT && !t->fd[FD_STDOUT]) {
+        for (i = 0; i < len; i++)
+            vga_putchar(buf[i], COLOR_DEFAULT);
+        return (int)len;
+    }
+    struct file *f = fd_get(t, fd);
+    if (!f || !FILE_WRITABLE(f)) return -1;
+    if (f->pipe) return pipe_write(f->pipe, buf, len);
+    struct fnode *fn = f->fn;
+    if (f->mode & O_APPEND) f->pos = fn->size;
+    /* Growing the file: the clusters must exist for write-back to put it on
+     * disk later, or the data would stay dirty in the cache for good. */
+    if (f->pos > file_max_size() || len > file_max_size() - f->pos) return -1;
+    if (f->pos + len > fn->size) {
+        unsigned int more = fat16_clusters(f->pos + len) - fat16_clusters(fn->size);
+        if (more && wb_unallocated() + more > fat16_free_clusters()) return -1;   /* disk full */
+    }
+    i = 0;
+    while (i < len) {
+        unsigned int idx = f->pos / PC_PAGE_SIZE;
+        unsigned int off = f->pos % PC_PAGE_SIZE;
+        unsigned int n   = PC_PAGE_SIZE - off;
+        if (n > len - i) n = len - i;
+
+        /* A page that is overwritten completely need not be read first */
+        struct cpage *p = pc_get(fn, idx, n != PC_PAGE_SIZE);
+        if (!p) return i ? (int)i : -1;
+        memcpy(p->data + off, buf + i, n);
+        if (p->dirty_lo == p->dirty_hi) {
+            p->dirty_lo   = off;
+            p->dirty_hi   = off + n;
+            p->dirty_tick = g_ticks;
+        } else {
+            if (off < p->dirty_lo)     p->dirty_lo = off;
+            if (off + n > p->dirty_hi) p->dirty_hi = off + n;
+        }
+        i      += n;
+        f->pos += n;
+        if (f->pos > fn->size) fn->size = f->pos;
+    }
+    return (int)len;
+}
+
+static int sys_read(struct fd_table *t, unsigned int fd, char *buf, unsigned int len)
+{
+    /* Not inside the disk transfer: map any mmap()ed target pages now */
+    if (user_prefault((unsigned int)buf, len, 1) < 0) return -1;
+    if (fd == FD_STDIN && !t->fd[FD_STDIN]) {
+        unsigned int i = 0;
+        /* Enable interrupts so background processes can run while we wait. */
+        __asm__ volatile("sti");
+        while (i < len) {
+            char c = 0;
+            while (!c) {
+                idle_hlt();
+                c = kbd_getchar();
+            }
+            buf[i++] = c;
+            vga_putchar(c, COLOR_DEFAULT);
+            serial_putchar(c);
+            if (c == '\n') break;
+        }
+        __asm__ volatile("cli");
+        return (int)i;
+    }
+    struct file *f = fd_get(t, fd);
+    if (!f || !FILE_READABLE(f)) return -1;
+    if (f->pipe) return pipe_read(f->pipe, buf, len);
+    struct fnode *fn = f->fn;
+    unsigned int i = 0;
+    while (i < len && f->pos < fn->size) {
+        unsigned int idx = f->pos / PC_PAGE_SIZE;
+        unsigned int off = f->pos % PC_PAGE_SIZE;
+        unsigned int n   = PC_PAGE_SIZE - off;
+        if (n > len - i)             n = len - i;
+        if (n > fn->size - f->pos)   n = fn->size - f->pos;
+
+        int miss = !pc_find(fn, idx);
+        unsigned int d = (miss && off == 0) ? file_direct_len(fn, f->pos, len - i) : 0;
+        /* Whole uncached pages: the sectors land in buf with no copy.  The
+         * chunk is faulted in right before, as pc_get and readahead in
+         * earlier rounds may have swapped part of buf out again; if that
+         * does not stick, the page goes through the cache instead. */
+        if (d && user_prefault((unsigned int)buf + i, d, 1) < 0) d = 0;
+        if (d) {
+            g_user_io = 1;
+            int got = fat16_pread(&fn->f, f->pos, (unsigned char *)buf + i, d);
+            g_user_io = 0;
+            if (got != (int)d) return i ? (int)i : -1;
+            g_rd_direct += (d + PC_PAGE_SIZE - 1) / PC_PAGE_SIZE;
+            i      += d;
+            f->pos += d;
+            f->ra_next = f->pos / PC_PAGE_SIZE;
+            continue;
+        }
+        struct cpage *p = pc_get(fn, idx, 1);
+        if (!p) return i ? (int)i : -1;
+        memcpy(buf + i, p->data + off, n);
+        i      += n;
+        f->pos += n;
+
+        /* After the copy: readahead may evict p if everything else is dirty */
+        if (miss) file_readahead(f, idx);
+        f->ra_next = idx + 1;
+    }
+    return (int)i;
+}
+
+#define PATH_MAX 128
+
+/*
+ * Copy a path from user space into dst[PATH_MAX].  fat16 must only see
+ * kernel copies: a fault on a user page in the middle of a FAT operation
+ * could start disk I/O of its own while g_sec0/g_sec1 are in use.
+ * -1 if the path does not fit.
+ */
+static int user_path(char *dst, const char *src)
+{
+    for (int i = 0; i < PATH_MAX; i++)
+        if ((dst[i] = src[i]) == '\0') return 0;
+    return -1;
+}
+
+static int sys_open(struct fd_table *t, const char *path, int flags)
+{
+    if ((flags & O_ACCMODE) == O_ACCMODE) return -1;
+    if ((flags & O_TRUNC) && (flags & O_ACCMODE) == O_RDONLY) return -1;
+
+    struct fat16_file h;
+    if (fat16_open(path, (flags & O_CREAT) ? FAT16_CREATE : 0, &h) < 0) return -1;
+    struct fnode *fn = fnode_get(&h);
+    if (!fn) return -1;
+
+    if (flags & O_TRUNC) {
+        if (pc_mapped(fn)) return -1;
+        pc_drop(fn);
+        if (fat16_truncate(&fn->f) < 0) return -1;
+        fn->size = 0;
+    }
+
+    struct file *f = file_alloc();
+    if (!f) return -1;
+    f->refs     = 1;
+    f->mode     = flags;
+    f->pos      = 0;
+    f->fn       = fn;
+    f->pipe     = 0;
+    f->ra_next  = 0;
+    f->ra_pages = 0;
+    fn->refs++;
+
+    int fd = fd_install(t, f);
+    if (fd < 0) file_put(f);
+    return fd;
+}
+
+/* Returns the new position, or -1 for a bad fd/whence or a result that is
+ * negative or past file_max_size(). */
+static int sys_lseek(struct fd_table *t, unsigned int fd, int off, int whence)
+{
+    struct file *f = fd_get(t, fd);
+    if (!f || f->pipe) return -1;
+
+    int base;
+    if      (whence == SEEK_SET) base = 0;
+    else if (whence == SEEK_CUR) base = (int)f->pos;
+    else if (whence == SEEK_END) base = (int)f->fn->size;
+    else return -1;
+
+    long long pos = (long long)base + off;              /* no int overflow */
+    if (pos < 0 || pos > file_max_size()) return -1;
+    f->pos = (unsigned int)pos;
+    return (int)f->pos;
+}
+
+/*
+ * Remove a file.  Its cached pages are discarded so they are never
+ * written into freed clusters; a file that is still open cannot be removed.
+ */
+static int sys_unlink(const char *path)
+{
+    struct fat16_file h;
+    if (fat16_open(path, 0, &h) == 0) {
+        for (int i = 0; i < FNODE_MAX; i++) {
+            struct fnode *fn = &g_fnodes[i];
+            if (!fn->used || fn->f.dirent_lba != h.dirent_lba ||
+                fn->f.dirent_off != h.dirent_off)
+                continue;
+            if (fn->refs) return -1;
+            pc_drop(fn);
+            fn->used = 0;
+        }
+    }
+    return fat16_delete(path);
+}
+
+struct iostat {
+    unsigned int read_cmds;       /* ATA READ SECTORS commands          */
+    unsigned int read_sectors;    /* sectors transferred by them        */
+    unsigned int ra_prefetched;   /* pages read ahead of demand         */
+    unsigned int ra_hits;         /* prefetched pages later used        */
+    unsigned int ra_waste;        /* prefetched pages dropped unused    */
+    unsigned int wb_pages;        /* dirty pages written back           */
+    unsigned int wb_flushes;      /* file write-backs                   */
+    unsigned int rd_direct;       /* pages read straight into user buffers */
+};
+
+static int sys_iostat(struct iostat *st)
+{
+    st->read_cmds     = g_ata_read_cmds;
+    st->read_sectors  = g_ata_read_sectors;
+    st->ra_prefetched = g_ra_prefetched;
+    st->ra_hits       = g_ra_hits;
+    st->ra_waste      = g_ra_waste;
+    st->wb_pages      = g_wb_pages;
+    st->wb_flushes    = g_wb_flushes;
+    st->rd_direct     = g_rd_direct;
+    return 0;
+}
+
+static int sys_close(struct fd_table *t, unsigned int fd)
+{
+    struct file *f = fd_get(t, fd);
+    if (!f) return -1;
+    t->fd[fd] = 0;
+    file_put(f);
+    return 0;
+}
+
+static struct file *pipe_end(struct pipe *p, int mode)
+{
+    struct file *f = file_alloc();
+    if (!f) return 0;
+    f->refs     = 1;
+    f->mode     = mode;
+    f->pos      = 0;
+    f->fn       = 0;
+    f->pipe     = p;
+    f->ra_next  = 0;
+    f->ra_pages = 0;
+    if (mode == O_WRONLY) p->writers++;
+    else                  p->readers++;
+    return f;
+}
+
+/* New pipe: fds[0] = read end, fds[1] = write end.  Returns 0, or -1 with nothing allocated. */
+static int sys_pipe(struct fd_table *t, int *fds)
+{
+    struct pipe *p = 0;
+    for (int i = 0; i < PIPE_MAX && !p; i++)
+        if (!g_pipes[i].data) p = &g_pipes[i];
+    if (!p) return -1;
+    p->data = (unsigned char *)pmm_alloc_kernel();
+    if (!p->data) return -1;
+    p->rd      = p->wr = 0;
+    p->readers = p->writers = 0;
+
+    struct file *r = pipe_end(p, O_RDONLY);
+    if (!r) { pmm_free((unsigned int)p->data); p->data = 0; return -1; }
+    struct file *w = pipe_end(p, O_WRONLY);
+    int rfd = w ? fd_install(t, r) : -1;
+    int wfd = rfd >= 0 ? fd_install(t, w) : -1;
+    if (wfd < 0) {   /* the last file_put frees the pipe */
+        if (rfd >= 0) t->fd[rfd] = 0;
+        if (w) file_put(w);
+        file_put(r);
+        return -1;
+    }
+    fds[0] = rfd;
+    fds[1] = wfd;
+    return 0;
+}
+
+/* Make newfd refer to oldfd's file, closing newfd first.  Returns newfd or -1. */
+static int sys_dup2(struct fd_table *t, unsigned int oldfd, unsigned int newfd)
+{
+    struct file *f = fd_get(t, oldfd);
+    if (!f || newfd >= FD_MAX) return -1;
+    if (oldfd == newfd) return (int)newfd;
+    if (newfd >= t->cap && fd_grow(t) < 0) return -1;
+    if (t->fd[newfd]) file_put(t->fd[newfd]);
+    f->refs++;
+    t->fd[newfd] = f;
+    return (int)newfd;
+}
+
+extern unsigned int exec_ret_esp;  /* defined in entry.asm; used by SYS_EXIT */
+static unsigned int g_exit_code;   /* set by SYS_EXIT, returned by SYS_EXEC */
+
+extern void tss_set_ring0_stack(unsigned int esp0);
+
+/* ============================================================
+ * Forward declarations needed by syscall_dispatch
+ * ============================================================ */
+
+/* Program loader constants */
+#define PROG_BASE      0x400000
+#define PROG_MAX_SIZE  (256 * 1024)
+#define ARGS_BASE      0x7FF000   /* args: VPN 1023, above the stack              */
+#define ARGS_MAX       200
+#define USER_STACK_TOP 0x7FF000
+#define STACK_VPN      1016       /* VPN 1016: guard page below the stack, unmapped */
+#ifndef STACK_MAX_PAGES
+#define STACK_MAX_PAGES 6         /* stack grows on #PF down to VPN 1017 (<= 6)    */
+#endif
+#if STACK_MAX_PAGES < 1 || STACK_MAX_PAGES > 6
+#error "STACK_MAX_PAGES: the stack has VPN 1017..1022 to grow into"
+#endif
+#define STACK_LOW      (USER_STACK_TOP - STACK_MAX_PAGES * PAGE_SIZE)
+#define HEAP_BASE      0x440000   /* first heap page (VPN 64, right after binary) */
+#define HEAP_MAX       0x700000   /* heap limit: VPN 767, below the mmap area      */
+#define MMAP_BASE      0x700000   /* mmap area: VPN 768..983, clear of the stacks  */
+#define MMAP_END       0x7D8000
+#define MMAP_MAX       8          /* mappings per process                          */
+#define THREAD_STACKS  0x7D8000   /* thread stacks: VPN 984..1015, below main stack */
+#define THREAD_STACK   0x4000     /* per thread: a guard page + 12 KB of stack     */
+#define THREAD_MAX     8          /* threads per process besides the main one      */
+
+#define PROT_READ      0x01
+#define PROT_WRITE     0x02
+#define MAP_SHARED     0x10       /* map the page-cache pages; writes reach the file */
+#define MAP_PRIVATE    0x20       /* map private copies                            */
+
+#define SHM_MAX        8          /* shared memory segments system-wide            */
+#define SHM_PAGES_MAX  64         /* 256 KB per segment                            */
+#define SHM_ATTACH_MAX 200        /* attachments per segment (pmm_refs is a byte)  */
+#define SHM_CREATE     0x01       /* shmat(): create the segment if the key is new */
+
+/*
+ * One range of the mmap area: [start, start + pages * 4 KB) shows file
+ * pages 0..pages-1, or the frames of a shared memory segment.
+ */
+struct vma {
+    unsigned int  start;          /* 0 = slot unused                  */
+    unsigned int  pages;
+    struct fnode *fn;             /* holds a reference (fn->refs)     */
+    struct shm   *shm;            /* instead of fn: attached segment  */
+    int           flags;          /* PROT_* | MAP_*                   */
+};
+#define PAGE_SIZE      4096
+#define PTE_COW        0x200      /* AVL bit: read-only until copied (fork) */
+#define PTE_GLOBAL     0x100      /* kernel mapping: kept across CR3 loads (CR4.PGE) */
+
+extern void         exec_run(unsigned int entry, unsigned int user_stack_top,
+                              unsigned int kstack_top);
+extern int            fat16_listdir(void (*cb)(const char *name, unsigned int size, int is_dir));
+extern int            fat16_mkdir(const char *name);
+extern int            fat16_rename(const char *src, const char *dst);
+extern int            fat16_chdir(const char *name);
+extern unsigned short fat16_get_cwd_cluster(void);
+extern void           fat16_set_cwd_cluster(unsigned short c);
+
+/* ============================================================
+ * Paging data structures
+ * ============================================================ */
+
+static unsigned int page_dir[1024]   __attribute__((aligned(4096)));
+static unsigned int pt_kernel[1024]  __attribute__((aligned(4096)));  /* 0–4 MB */
+
+/*
+ * Direct map: physical memory below 1 GB appears again at KERNEL_DIRECT + pa
+ * in the top quarter of every page directory (PDE[768–1023], supervisor,
+ * global).  Unlike the identity map it also covers 4–8 MB, which processes
+ * map their user PT over, so the kernel reaches any frame without a CR3
+ * switch.
+ */
+#define KERNEL_DIRECT   0xC0000000u
+#define P2V(pa)         ((void *)((unsigned int)(pa) + KERNEL_DIRECT))
+
+#define CR4_PSE         (1u << 4)
+#define CR4_PGE         (1u << 7)
+#define TLB_FLUSH_PAGES 16        /* larger ranges: reload CR3 instead of invlpg */
+
+static inline unsigned int read_cr3(void)
+{
+    unsigned int cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    return cr3;
+}
+
+/*
+ * Drop the TLB entries of user pages [va, va + pages * 4 KB) of the current
+ * address space after their PTEs were cleared or write-protected: invlpg for
+ * a few pages, else a CR3 reload, which leaves the global kernel entries
+ * alone.  Mapping a page where there was none needs no flush, as the TLB
+ * never holds not-present translations.
+ */
+static void tlb_flush_range(unsigned int va, unsigned int pages)
+{
+    if (pages > TLB_FLUSH_PAGES) {
+        __asm__ volatile("mov %0, %%cr3" :: "r"(read_cr3()) : "memory");
+        return;
+    }
+    for (unsigned int i = 0; i < pages; i++, va += PAGE_SIZE)
+        __asm__ volatile("invlpg (%0)" :: "r"(va) : "memory");
+}
+
+/* Fill the kernel half of page directory pd: PDE[2–511] identity, 4 MB PSE
+ * pages for 8 MB–2 GB, and the direct map.  PDE[0] and PDE[1] are the
+ * caller's. */
+static void pd_kernel_init(unsigned int *pd)
+{
+    for (int i = 2; i < 512; i++)
+        pd[i] = (unsigned int)(i << 22) | 0x83 | PTE_GLOBAL;   /* P+RW+PS, U=0 */
+    for (int i = 0; i < 256; i++)
+        pd[(KERNEL_DIRECT >> 22) + i] = (unsigned int)(i << 22) | 0x83 | PTE_GLOBAL;
+}
+
+/* ============================================================
+ * Process Control Block
+ * ============================================================ */
+
+#define PROC_MAX_PROCS  32
+#define PROC_MAX_FRAMES  2   /* phys_frames[0]=PD, phys_frames[1]=PT; user pages freed by region */
+
+typedef enum { PROC_UNUSED=0, PROC_RUNNING, PROC_READY, PROC_ZOMBIE,
+               PROC_SLEEPING, PROC_WAITING, PROC_BLOCKED } proc_state_t;
+
+/* Message passing: a fixed-size message, same layout as in os.h */
+#define MSG_WORDS 8
+
+struct msg {
+    unsigned int w[MSG_WORDS];
+};
+
+typedef enum { IPC_IDLE=0,
+               IPC_RECV,      /* blocked in msg_receive()                */
+               IPC_SEND,      /* request queued at ipc_peer              */
+               IPC_REPLY,     /* request taken, waiting for the reply    */
+               IPC_DONE,      /* reply is in ipc_msg                     */
+               IPC_FAILED     /* ipc_peer exited without replying        */
+             } ipc_state_t;
 
 struct process {
     int            pid;
+    int            parent_pid;                 /* 0 = orphan (parent gone)            */
     proc_state_t   state;
     char           name[16];                   /* program name (e.g. "sh", "hello")   */
 
@@ -845,10 +1921,16 @@ struct process {
     int            n_frames;
 
     unsigned int   heap_break;                 /* current heap break (sbrk)           */
+    unsigned int   resident;                   /* present PTEs in the user PT         */
+    unsigned int   swapped;                    /* PTEs naming a swap slot             */
+    unsigned int   rss_limit;                  /* resident pages allowed, 0 = no limit */
+    unsigned int   heap_limit;                 /* heap pages allowed, 0 = no limit    */
+    unsigned int   swap_hand;                  /* clock hand over its own pages       */
 
     unsigned int   saved_exec_ret_esp;         /* exec_ret_esp of parent */
 
     unsigned int   wakeup_tick;                /* g_ticks value at which to wake up   */
+    void          *wait_chan;                  /* PROC_BLOCKED: what we sleep on      */
 
     unsigned int   phys_kstack;                /* physical address of per-process ring-0 stack */
     unsigned int   saved_esp;                  /* saved kernel ESP for context switch */
@@ -857,12 +1939,43 @@ struct process {
 
     int            is_background;             /* 1 = background, 0 = foreground      */
     unsigned int   saved_cwd_cluster;         /* FAT16 CWD at launch (BG exit restore) */
+
+    struct process *owner;                    /* thread: process it runs in; 0 = main */
+    unsigned int   thread_slots;              /* main: bitmap of used thread stacks   */
+    int            stack_slot;                /* thread: its slot below the main stack */
+
+    struct fd_table files;                    /* open files, private to the process  */
+    struct vma     mmaps[MMAP_MAX];           /* mmap() area: files and shm segments */
+
+    ipc_state_t    ipc_state;                 /* msg_send/receive progress            */
+    int            ipc_peer;                  /* IPC_SEND/REPLY: receiver pid         */
+    unsigned int   ipc_seq;                   /* IPC_SEND: arrival order at receiver  */
+    struct msg     ipc_msg;                   /* request while sending, then reply    */
+
+    int            fpu_used;                  /* fpu_state holds valid saved state    */
+    unsigned char  fpu_state[512] __attribute__((aligned(16)));  /* FXSAVE area   */
 };
 
 static struct process  g_procs[PROC_MAX_PROCS];
-static struct process *g_current = 0;
+static struct process *g_current  = 0;
+static int             g_next_pid = 1;   /* PIDs are never reused while the system runs */
+
+static void process_destroy(struct process *p);  /* forward declarations */
+static void process_reap(struct process *p);
 
-static void process_destroy(struct process *p);  /* forward declaration */
+/* The process whose address space, files and mappings p uses: p itself,
+ * or for a thread the process it was created in. */
+static inline struct process *proc_owner(struct process *p)
+{
+    return p->owner ? p->owner : p;
+}
+
+/* One past the last VPN of p's binary and heap: sbrk() keeps exactly the
+ * pages below heap_break mapped. */
+static inline unsigned int heap_end_vpn(struct process *p)
+{
+    return (p->heap_break - PROG_BASE + PAGE_SIZE - 1) / PAGE_SIZE;
+}
 
 /* ── panic screen — full implementation (needs g_current, g_ticks, PCB types) ─── */
 
@@ -886,6 +1999,7 @@ static const char *proc_state_name(proc_state_t s)
     case PROC_RUNNING:  return "RUNNING";
     case PROC_READY:    return "READY";
     case PROC_WAITING:  return "WAITING";
+    case PROC_BLOCKED:  return "BLOCKED";
     case PROC_SLEEPING: return "SLEEPING";
     case PROC_ZOMBIE:   return "ZOMBIE";
     default:            return "?";
@@ -940,555 +2054,2161 @@ static void panic_screen(const char *msg, struct registers *r)
     ps_reg(vga, 13, 22, "FS",  r->fs, PANIC_BODY);
     ps_reg(vga, 13, 42, "GS",  r->gs, PANIC_BODY);
 
-    /* Exception: INT number, error code, uptime ticks */
-    ps_str(vga, 15,  1, "Exception", PANIC_HDR);
-    ps_reg(vga, 16,  2, "INT",    r->int_no,   PANIC_BODY);
-    ps_reg(vga, 16, 22, "ERR",    r->err_code, PANIC_BODY);
-    ps_str(vga, 16, 42, "Ticks ", PANIC_HDR);
-    ps_dec(vga, 16, 48, g_ticks,  PANIC_BODY);
+    /* Exception: INT number, error code, uptime ticks */
+    ps_str(vga, 15,  1, "Exception", PANIC_HDR);
+    ps_reg(vga, 16,  2, "INT",    r->int_no,   PANIC_BODY);
+    ps_reg(vga, 16, 22, "ERR",    r->err_code, PANIC_BODY);
+    ps_str(vga, 16, 42, "Ticks ", PANIC_HDR);
+    ps_dec(vga, 16, 48, g_ticks,  PANIC_BODY);
+
+    /* For #PF (INT 14): decode the error code into human-readable flags */
+    if (r->int_no == 14) {
+        unsigned int e = r->err_code;
+        int col = 2;
+        ps_str(vga, 17, col, "#PF:", PANIC_HDR); col += 5;
+        ps_str(vga, 17, col, (e & 1)  ? "PROT-VIOL"   : "NOT-PRESENT", PANIC_BODY); col += 12;
+        ps_str(vga, 17, col, (e & 2)  ? "WRITE"       : "READ",        PANIC_BODY); col +=  6;
+        ps_str(vga, 17, col, (e & 4)  ? "USER"        : "KERNEL",      PANIC_BODY); col +=  7;
+        ps_str(vga, 17, col, (e & 16) ? "INSTR-FETCH" : "DATA",        PANIC_BODY);
+    }
+
+    /* Current process */
+    ps_str(vga, 19,  1, "Current Process", PANIC_HDR);
+    if (g_current) {
+        int col = 2;
+        ps_str(vga, 20, col, "PID ",  PANIC_HDR); col += 4;
+        col = ps_dec(vga, 20, col, (unsigned int)g_current->pid, PANIC_BODY);
+        col += 2;
+        ps_str(vga, 20, col, "Name ", PANIC_HDR); col += 5;
+        ps_str(vga, 20, col, g_current->name, PANIC_BODY);
+        col += 16;
+        ps_str(vga, 20, col, "State ", PANIC_HDR); col += 6;
+        ps_str(vga, 20, col, proc_state_name(g_current->state), PANIC_BODY);
+        col += 8;
+        ps_str(vga, 20, col, "BG ", PANIC_HDR); col += 3;
+        ps_str(vga, 20, col, g_current->is_background ? "yes" : "no", PANIC_BODY);
+    } else {
+        ps_str(vga, 20, 2, "(no process)", PANIC_BODY);
+    }
+
+    /* Serial dump */
+    serial_print("[PANIC] "); serial_print(msg); serial_putchar('\n');
+    serial_print("[PANIC] EAX="); serial_hex(r->eax);
+    serial_print(" EBX=");        serial_hex(r->ebx);
+    serial_print(" ECX=");        serial_hex(r->ecx);
+    serial_print(" EDX=");        serial_hex(r->edx); serial_putchar('\n');
+    serial_print("[PANIC] ESI="); serial_hex(r->esi);
+    serial_print(" EDI=");        serial_hex(r->edi);
+    serial_print(" EBP=");        serial_hex(r->ebp);
+    serial_print(" ESP=");        serial_hex(r->esp); serial_putchar('\n');
+    serial_print("[PANIC] EIP="); serial_hex(r->eip);
+    serial_print(" EFLAGS=");     serial_hex(r->eflags);
+    serial_print(" CS=");         serial_hex(r->cs);
+    serial_print(" DS=");         serial_hex(r->ds);  serial_putchar('\n');
+    serial_print("[PANIC] ES=");  serial_hex(r->es);
+    serial_print(" FS=");         serial_hex(r->fs);
+    serial_print(" GS=");         serial_hex(r->gs);  serial_putchar('\n');
+    serial_print("[PANIC] CR0="); serial_hex(cr0);
+    serial_print(" CR2=");        serial_hex(cr2);
+    serial_print(" CR3=");        serial_hex(cr3);
+    serial_print(" CR4=");        serial_hex(cr4);    serial_putchar('\n');
+    serial_print("[PANIC] INT="); serial_hex(r->int_no);
+    serial_print(" ERR=");        serial_hex(r->err_code);
+    serial_print(" TICKS=");      serial_hex(g_ticks); serial_putchar('\n');
+    if (g_current) {
+        serial_print("[PANIC] PID=");
+        serial_hex((unsigned int)g_current->pid);
+        serial_print(" NAME="); serial_print(g_current->name);
+        serial_print(" STATE="); serial_print(proc_state_name(g_current->state));
+        serial_putchar('\n');
+    }
+    serial_flush();   /* IRQs stay off from here on — drain by polling */
+}
+
+/* ============================================================
+ * Lazy FPU / SSE context switching
+ *
+ * CR0.TS is set whenever the running process is not the one whose state
+ * is loaded in the FPU (fpu_owner).  Its first x87/MMX/SSE instruction
+ * then raises #NM (int 7); fpu_nm_trap() saves the owner's registers,
+ * loads (or initialises) the current process's, and clears TS.  Processes
+ * that never touch the FPU never pay for an FXSAVE.  The kernel itself
+ * never uses FPU/SSE registers.
+ * ============================================================ */
+
+#define CR0_MP          (1u << 1)
+#define CR0_EM          (1u << 2)
+#define CR0_TS          (1u << 3)
+#define CR0_NE          (1u << 5)
+#define CR4_OSFXSR      (1u << 9)
+#define CR4_OSXMMEXCPT  (1u << 10)
+#define MXCSR_DEFAULT   0x1F80     /* all SIMD exceptions masked */
+
+static struct process *fpu_owner = 0;
+static int             fpu_fxsr  = 0;   /* CPU has FXSAVE/FXRSTOR (and SSE) */
+
+static void fpu_init(void)
+{
+    unsigned int eax = 1, ebx, ecx, edx, cr0, cr4;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    fpu_fxsr = (edx >> 24) & 1;
+
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    cr0 = (cr0 & ~CR0_EM) | CR0_MP | CR0_NE;
+    __asm__ volatile ("mov %0, %%cr0" :: "r"(cr0));
+    if (fpu_fxsr) {
+        __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR;
+        if ((edx >> 25) & 1)            /* SSE: deliver #XM, not #UD */
+            cr4 |= CR4_OSXMMEXCPT;
+        __asm__ volatile ("mov %0, %%cr4" :: "r"(cr4));
+    }
+    __asm__ volatile ("fninit");
+    __asm__ volatile ("mov %%cr0, %0\n or %1, %0\n mov %0, %%cr0"
+                      : "=&r"(cr0) : "i"(CR0_TS));   /* nobody owns the FPU yet */
+}
+
+/* Set or clear CR0.TS for process p about to run. */
+static void fpu_switch_to(struct process *p)
+{
+    unsigned int cr0;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    unsigned int want = (p == fpu_owner) ? (cr0 & ~CR0_TS) : (cr0 | CR0_TS);
+    if (want != cr0)
+        __asm__ volatile ("mov %0, %%cr0" :: "r"(want));
+}
+
+/* #NM: hand the FPU to g_current. */
+static void fpu_nm_trap(void)
+{
+    __asm__ volatile ("clts");
+    if (fpu_owner == g_current) return;
+    if (fpu_owner) {
+        if (fpu_fxsr) __asm__ volatile ("fxsave %0" : "=m"(fpu_owner->fpu_state));
+        else          __asm__ volatile ("fnsave %0" : "=m"(fpu_owner->fpu_state));
+    }
+    if (g_current->fpu_used) {
+        if (fpu_fxsr) __asm__ volatile ("fxrstor %0" :: "m"(g_current->fpu_state));
+        else          __asm__ volatile ("frstor %0"  :: "m"(g_current->fpu_state));
+    } else {
+        unsigned int mxcsr = MXCSR_DEFAULT;
+        __asm__ volatile ("fninit");
+        if (fpu_fxsr) __asm__ volatile ("ldmxcsr %0" :: "m"(mxcsr));
+        g_current->fpu_used = 1;
+    }
+    fpu_owner = g_current;
+}
+
+/* Forget p's FPU state when p goes away (no need to save it). */
+static void fpu_release(struct process *p)
+{
+    if (fpu_owner == p) fpu_owner = 0;
+    p->fpu_used = 0;
+}
+
+/*
+ * Direct switch: msg_send() and msg_reply() name the partner that should
+ * run next, so it gets the CPU without waiting for its round-robin turn.
+ */
+static struct process *g_handoff = 0;
+
+/* Round-robin: find next READY or RUNNING process (never returns g_current). */
+static struct process *pick_next_process(void)
+{
+    if (!g_current) return 0;
+    struct process *h = g_handoff;
+    g_handoff = 0;
+    if (h && h != g_current && (h->state == PROC_READY || h->state == PROC_RUNNING))
+        return h;
+    int cur = (int)(g_current - g_procs);
+    int i;
+    for (i = 1; i < PROC_MAX_PROCS; i++) {
+        int j = (cur + i) % PROC_MAX_PROCS;
+        proc_state_t s = g_procs[j].state;
+        if (s == PROC_READY || s == PROC_RUNNING)
+            return &g_procs[j];
+    }
+    return 0;
+}
+
+/*
+ * schedule — switch from g_current to the next runnable process.
+ * r is the register frame of the current interrupt/syscall; it becomes the
+ * process's saved context (unless it is a zombie that will never resume).
+ * Returns the ESP to switch to, or 0 if nothing else is runnable.
+ * Shared by IRQ0 (preemption), SYS_YIELD and int 0x81 (in-kernel blocking).
+ */
+static unsigned int schedule(struct registers *r)
+{
+    if (!g_current) return 0;
+    struct process *next = pick_next_process();
+    if (!next) return 0;
+    if (g_current->state != PROC_ZOMBIE) {
+        /* Save current process's context */
+        g_current->saved_esp = (unsigned int)r;
+        if (g_current->state == PROC_RUNNING)
+            g_current->state = PROC_READY;
+    }
+    /* Switch to next process (works for both normal and zombie) */
+    next->state = PROC_RUNNING;
+    g_current   = next;
+    if (read_cr3() != next->cr3)   /* threads of one process share a PD */
+        __asm__ volatile("mov %0, %%cr3" :: "r"(next->cr3) : "memory");
+    tss_set_ring0_stack(next->phys_kstack + PAGE_SIZE);
+    fpu_switch_to(next);
+    return next->saved_esp;
+}
+
+/*
+ * sleep_on — block g_current until wakeup(chan) is called.
+ * Called from syscall context with interrupts disabled.  int 0x81 switches
+ * to another process right away instead of waiting for the next PIT tick;
+ * if nothing else is runnable we halt until an interrupt changes that.
+ */
+static void sleep_on(void *chan)
+{
+    g_current->wait_chan = chan;
+    g_current->state     = PROC_BLOCKED;
+    __asm__ volatile("sti");
+    while (g_current->state == PROC_BLOCKED) {
+        __asm__ volatile("int $0x81");
+        if (g_current->state == PROC_BLOCKED)
+            idle_hlt();
+    }
+    __asm__ volatile("cli");
+    g_current->wait_chan = 0;
+}
+
+/* wakeup — make every process blocked on chan runnable again. */
+static void wakeup(void *chan)
+{
+    for (int i = 0; i < PROC_MAX_PROCS; i++) {
+        struct process *p = &g_procs[i];
+        if (p->state == PROC_BLOCKED && p->wait_chan == chan)
+            p->state = (p == g_current) ? PROC_RUNNING : PROC_READY;
+    }
+}
+
+/* ============================================================
+ * Swap — user pages paged out to a file on the FAT16 volume
+ *
+ * SWAP_FILE is created (and zero-filled once) at boot and then read and
+ * written a page at a time with fat16_pread/pwrite, which go straight to
+ * the disk: swap I/O never needs a page-cache frame.  A paged-out PTE is
+ * not present and holds PTE_SWAP plus the slot number in the frame bits;
+ * swap_refs[] counts the PTEs naming each slot, as fork() shares them.
+ *
+ * When pmm_alloc() finds no frame, user_frame_alloc() evicts one with the
+ * clock (second-chance) algorithm: the hand sweeps the binary, heap and
+ * stack pages of every process, clearing PTE accessed bits, and takes
+ * the first unshared page whose bit is still clear — pages of idle
+ * processes first; the process asking for memory is only a victim from
+ * the third lap on.  A process at its RSS limit (rss_limit) runs the same
+ * clock over its own pages only.  A later access faults the page back in
+ * (swap_fault).  When nothing can be paged out, oom_kill() frees memory.
+ *
+ * A page fault from CPL0 interrupts a syscall that may be in the middle
+ * of a FAT or page-cache operation.  While it is handled g_reclaim_noio
+ * is set: reclaim may only free clean page-cache frames (pc_shrink) and
+ * the fault fails rather than swap, flush or kill.  A fault while
+ * g_user_io is set, i.e. inside a PIO transfer into a user buffer, is
+ * not served at all.
+ * ============================================================ */
+
+#define SWAP_FILE   "/SWAP.SYS"
+#define SWAP_SLOTS  128                /* 512 KB */
+#define PTE_SWAP    0x400              /* AVL bit with P=0: page is in slot pte >> 12 */
+#define PTE_A       0x20               /* accessed, set by the CPU */
+
+static struct fat16_file swap_file;
+static int               swap_ready;
+static unsigned char     swap_refs[SWAP_SLOTS];   /* 0 = free slot */
+static unsigned int      swap_used;
+static int               g_reclaim_noio;          /* reclaim without disk I/O */
+static int               swap_hand_proc;          /* clock hand: process ... */
+static unsigned int      swap_hand_vpn;           /* ... and page            */
+
+/* Open (or create) the swap file.  Without it, swap stays off. */
+static void swap_init(void)
+{
+    if (fat16_open(SWAP_FILE, FAT16_CREATE, &swap_file) < 0) return;
+    if (swap_file.size < SWAP_SLOTS * PAGE_SIZE) {
+        unsigned int zero = pmm_alloc_kernel();
+        if (!zero) return;
+        memset((void *)zero, 0, PAGE_SIZE);
+        int ok = fat16_reserve(&swap_file, SWAP_SLOTS * PAGE_SIZE) == 0;
+        for (unsigned int i = 0; ok && i < SWAP_SLOTS; i++)
+            ok = fat16_pwrite(&swap_file, i * PAGE_SIZE, (const unsigned char *)zero,
+                              PAGE_SIZE) == PAGE_SIZE;
+        pmm_free(zero);
+        if (!ok || fat16_sync(&swap_file) < 0) return;
+    }
+    swap_ready = 1;
+}
+
+static int swap_get(void)
+{
+    for (int i = 0; i < SWAP_SLOTS; i++)
+        if (!swap_refs[i]) { swap_refs[i] = 1; swap_used++; return i; }
+    return -1;
+}
+
+/* Drop one reference to slot */
+static void swap_put(unsigned int slot)
+{
+    if (--swap_refs[slot] == 0) swap_used--;
+}
+
+/* Present binary, heap and stack pages whose frame mm does not share
+ * (a copy-on-write page nobody else maps any more qualifies) */
+static int swap_eligible(struct process *mm, unsigned int vpn)
+{
+    unsigned int pte = ((unsigned int *)mm->phys_frames[1])[vpn];
+    if (vpn >= heap_end_vpn(mm) && vpn < STACK_VPN) return 0;
+    if ((pte & 0x05) != 0x05) return 0;
+    return !pmm_shared(pte & ~0xFFFu);
+}
+
+/* Clock test of page vpn of mm: 1 = a victim, eligible and not accessed
+ * since the hand last passed; an accessed page loses its bit instead. */
+static int swap_victim(struct process *mm, unsigned int vpn)
+{
+    if (!swap_eligible(mm, vpn)) return 0;
+    unsigned int *pt = (unsigned int *)mm->phys_frames[1];
+    if (!(pt[vpn] & PTE_A)) return 1;
+    pt[vpn] &= ~PTE_A;                           /* used lately: second chance */
+    if (read_cr3() == mm->cr3) tlb_flush_range(PROG_BASE + vpn * PAGE_SIZE, 1);
+    return 0;
+}
+
+/* Write page vpn of mm to a free slot and free its frame.  0 = done. */
+static int swap_out(struct process *mm, unsigned int vpn)
+{
+    unsigned int *pt    = (unsigned int *)mm->phys_frames[1];
+    unsigned int  frame = pt[vpn] & ~0xFFFu;
+    int slot = swap_get();
+    if (slot < 0) return -1;
+    if (fat16_pwrite(&swap_file, (unsigned int)slot * PAGE_SIZE, P2V(frame),
+                     PAGE_SIZE) != PAGE_SIZE) {
+        swap_put((unsigned int)slot);
+        return -1;
+    }
+    pt[vpn] = (unsigned int)slot << 12 | PTE_SWAP;
+    if (read_cr3() == mm->cr3) tlb_flush_range(PROG_BASE + vpn * PAGE_SIZE, 1);
+    pmm_free(frame);
+    mm->resident--;
+    mm->swapped++;
+    return 0;
+}
+
+/* Evict one user page by the clock algorithm.  0 = a frame was freed. */
+static int swap_evict(void)
+{
+    if (!swap_ready || swap_used == SWAP_SLOTS) return -1;
+    struct process *self = g_current ? proc_owner(g_current) : 0;
+    for (int laps = 0; laps < 4; ) {
+        struct process *mm = &g_procs[swap_hand_proc];
+        if (mm->state == PROC_UNUSED || mm->state == PROC_ZOMBIE || mm->owner ||
+            mm->n_frames < 2 || swap_hand_vpn >= 1024) {
+            swap_hand_vpn  = 0;
+            swap_hand_proc = (swap_hand_proc + 1) % PROC_MAX_PROCS;
+            if (swap_hand_proc == 0) laps++;
+            continue;
+        }
+        unsigned int vpn = swap_hand_vpn++;
+        if (vpn == heap_end_vpn(mm)) { swap_hand_vpn = STACK_VPN; continue; }
+        if (!swap_victim(mm, vpn)) continue;
+        if (mm == self && laps < 2) continue;
+        return swap_out(mm, vpn);
+    }
+    return -1;
+}
+
+/* Evict one page of mm itself, which has reached its RSS limit: the clock
+ * over mm's pages only, on its own hand.  0 = a frame was freed. */
+static int swap_evict_own(struct process *mm)
+{
+    if (!swap_ready || g_reclaim_noio || swap_used == SWAP_SLOTS) return -1;
+    for (int n = 0; n < 2 * 1024; n++) {        /* two laps at most */
+        unsigned int vpn = mm->swap_hand % 1024;
+        mm->swap_hand = vpn + 1 == heap_end_vpn(mm) ? STACK_VPN : vpn + 1;
+        if (swap_victim(mm, vpn)) return swap_out(mm, vpn);
+    }
+    return -1;
+}
+
+static int oom_kill(void);
+
+/* Make room in a full PMM: page a user page out or, failing that, kill
+ * a process.  Under g_reclaim_noio only drop a clean cached page.
+ * 0 = some frame was freed. */
+static int mem_reclaim(void)
+{
+    if (g_reclaim_noio) return pc_shrink();
+    return swap_evict() == 0 || oom_kill() == 0 ? 0 : -1;
+}
+
+/* A frame for a user page of mm (0 = nobody's yet: not limited).  At its
+ * RSS limit mm pages out one of its own pages first, or gets nothing. */
+static unsigned int user_frame_alloc(struct process *mm)
+{
+    if (mm && mm->rss_limit && mm->resident >= mm->rss_limit &&
+        swap_evict_own(mm) < 0) return 0;
+    unsigned int pa = pmm_alloc();
+    while (!pa && mem_reclaim() == 0) pa = pmm_alloc();
+    return pa;
+}
+
+/* pmm_alloc_kernel(), reclaiming memory if the PMM is full */
+static unsigned int kernel_frame_alloc(void)
+{
+    unsigned int pa = pmm_alloc_kernel();
+    while (!pa && mem_reclaim() == 0) pa = pmm_alloc_kernel();
+    return pa;
+}
+
+/* Read the page at addr back from swap.  0 = mapped. */
+static int swap_fault(unsigned int addr)
+{
+    if (addr < PROG_BASE || addr >= PROG_BASE + 1024 * PAGE_SIZE) return -1;
+    struct process *mm  = proc_owner(g_current);
+    unsigned int   *pt  = (unsigned int *)mm->phys_frames[1];
+    unsigned int    vpn = (addr - PROG_BASE) / PAGE_SIZE;
+    if ((pt[vpn] & 0x01) || !(pt[vpn] & PTE_SWAP)) return -1;
+    unsigned int fr = user_frame_alloc(mm);
+    if (!fr) return -1;
+    unsigned int slot = pt[vpn] >> 12;
+    if (fat16_pread(&swap_file, slot * PAGE_SIZE, P2V(fr), PAGE_SIZE) != PAGE_SIZE) {
+        pmm_free(fr);
+        return -1;
+    }
+    swap_put(slot);
+    pt[vpn] = fr | 0x07;                                /* P+RW+U */
+    mm->resident++;
+    mm->swapped--;
+    return 0;
+}
+
+/* Page out the eligible pages of [addr, addr + len) of the caller now.
+ * Returns the number of pages written, or -1 (no swap, bad range). */
+static int sys_pageout(unsigned int addr, unsigned int len)
+{
+    unsigned int top = PROG_BASE + 1024 * PAGE_SIZE;   /* end of the user PT */
+    if (!swap_ready || addr < PROG_BASE || addr >= top || len > top - addr)
+        return -1;
+    struct process *mm = proc_owner(g_current);
+    int n = 0;
+    for (unsigned int va = addr & ~0xFFFu; va < addr + len; va += PAGE_SIZE) {
+        unsigned int vpn = (va - PROG_BASE) / PAGE_SIZE;
+        if (!swap_eligible(mm, vpn)) continue;
+        if (swap_out(mm, vpn) < 0) break;
+        n++;
+    }
+    return n;
+}
+
+/* Free the present pages among VPNs [from, to) of p's user PT, and the
+ * swap slots of the paged-out ones. */
+static void pt_free_range(struct process *p, unsigned int from, unsigned int to)
+{
+    unsigned int *pt = (unsigned int *)p->phys_frames[1];
+    for (unsigned int vpn = from; vpn < to; vpn++) {
+        if (pt[vpn] & PTE_SWAP) { swap_put(pt[vpn] >> 12); pt[vpn] = 0; p->swapped--; }
+        if (!(pt[vpn] & 0x01)) continue;
+        pmm_free(pt[vpn] & ~0xFFFu);
+        pt[vpn] = 0;
+        p->resident--;
+    }
+}
+
+/*
+ * process_abort — undo a process_alloc()/process_create() that failed
+ * half-way: free the user pages already mapped, the PT, PD and kernel
+ * stack, and release the slot.
+ */
+static void process_abort(struct process *p)
+{
+    if (p->n_frames >= 2) {
+        pt_free_range(p, 0, heap_end_vpn(p));   /* binary; no heap yet */
+        pt_free_range(p, STACK_VPN, 1024);
+        pmm_free(p->phys_frames[1]);         /* PT itself */
+    }
+    if (p->n_frames >= 1) pmm_free(p->phys_frames[0]);  /* PD */
+    if (p->phys_kstack)   pmm_free(p->phys_kstack);
+    p->n_frames    = 0;
+    p->phys_kstack = 0;
+    p->state       = PROC_UNUSED;
+}
+
+/*
+ * proc_slot — claim a free PCB slot and reset it for a new process or
+ * thread.  The slot stays PROC_UNUSED until the caller has filled in the
+ * rest; returns 0 if all slots are taken.
+ */
+static struct process *proc_slot(const char *name)
+{
+    int i, slot = -1;
+    for (i = 0; i < PROC_MAX_PROCS; i++) {
+        /* Orphaned zombies have nobody left to waitpid() for them */
+        if (g_procs[i].state == PROC_ZOMBIE && g_procs[i].parent_pid == 0)
+            process_reap(&g_procs[i]);
+        if (g_procs[i].state == PROC_UNUSED) { slot = i; break; }
+    }
+    if (slot < 0) return 0;
+
+    struct process *p = &g_procs[slot];
+    p->n_frames      = 0;
+    p->pid           = g_next_pid++;
+    p->parent_pid    = g_current ? proc_owner(g_current)->pid : 0;
+    p->wait_chan     = 0;
+    p->fpu_used      = 0;
+    p->ipc_state     = IPC_IDLE;
+    fd_table_init(&p->files);
+    for (i = 0; i < MMAP_MAX; i++) p->mmaps[i].start = 0;
+    p->heap_break    = HEAP_BASE;
+    p->resident      = 0;
+    p->swapped       = 0;
+    p->swap_hand     = 0;
+    /* Limits are inherited from the creating process, like ulimit */
+    p->rss_limit     = g_current ? proc_owner(g_current)->rss_limit  : 0;
+    p->heap_limit    = g_current ? proc_owner(g_current)->heap_limit : 0;
+    p->phys_kstack   = 0;
+    p->is_background = 0;
+    p->owner         = 0;
+    p->thread_slots  = 0;
+    {   /* copy name, truncate to 15 chars */
+        int ni = 0;
+        while (name[ni] && ni < 15) { p->name[ni] = name[ni]; ni++; }
+        p->name[ni] = '\0';
+    }
+    return p;
+}
+
+/*
+ * process_alloc — claim a PCB slot and give it an empty address space:
+ * a page directory (shared kernel PT + PSE identity and direct map), a
+ * zeroed user PT and a kernel stack.  The slot stays PROC_UNUSED until the
+ * caller has filled in the rest; returns 0 if no slot or frame is left.
+ */
+static struct process *process_alloc(const char *name)
+{
+    struct process *p = proc_slot(name);
+    if (!p) return 0;
+
+    /* [1] Allocate page directory */
+    unsigned int pd_phys = kernel_frame_alloc();
+    if (!pd_phys) return 0;
+    p->phys_frames[0] = pd_phys;
+    p->n_frames       = 1;
+    p->cr3            = pd_phys;
+
+    /* [2] Allocate user page table; clear it immediately */
+    unsigned int pt_phys = kernel_frame_alloc();
+    if (!pt_phys) { process_abort(p); return 0; }
+    p->phys_frames[1] = pt_phys;
+    p->n_frames       = 2;
+    memset((void *)pt_phys, 0, PAGE_SIZE);
+
+    /* [3] Allocate kernel stack; the caller builds the first context frame */
+    p->phys_kstack = kernel_frame_alloc();
+    if (!p->phys_kstack) { process_abort(p); return 0; }
+    p->saved_cwd_cluster = fat16_get_cwd_cluster();
+
+    /* [4] Build page directory */
+    unsigned int *pd = (unsigned int *)pd_phys;
+    memset(pd, 0, PAGE_SIZE);
+    pd[0] = (unsigned int)pt_kernel | 0x07;   /* shared kernel PT, 0–4 MB */
+    pd[1] = pt_phys | 0x07;                   /* user PT                   */
+    pd_kernel_init(pd);                       /* identity + direct map     */
+    return p;
+}
+
+/*
+ * kstack_init — build p's first ring-3 context frame on its kernel stack.
+ * The frame mirrors what isr_common pushes when preempting a ring-3 process,
+ * allowing the scheduler to start p at eip on user stack esp via context
+ * switch on its first run.
+ */
+static void kstack_init(struct process *p, unsigned int eip, unsigned int esp)
+{
+    unsigned int *kst = (unsigned int *)(p->phys_kstack + PAGE_SIZE);
+    *(--kst) = 0x23;            /* user SS  (ring-3 data selector)   */
+    *(--kst) = esp;             /* user ESP                          */
+    *(--kst) = 0x3200;          /* EFLAGS: IF=1, IOPL=3              */
+    *(--kst) = 0x1B;            /* user CS  (ring-3 code selector)   */
+    *(--kst) = eip;             /* user EIP                          */
+    *(--kst) = 0;               /* err_code (dummy)                  */
+    *(--kst) = 0;               /* int_no   (dummy)                  */
+    /* pusha order on stack: EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI */
+    *(--kst) = 0;               /* EAX */
+    *(--kst) = 0;               /* ECX */
+    *(--kst) = 0;               /* EDX */
+    *(--kst) = 0;               /* EBX */
+    *(--kst) = 0;               /* ESP (ignored by popa) */
+    *(--kst) = 0;               /* EBP */
+    *(--kst) = 0;               /* ESI */
+    *(--kst) = 0;               /* EDI */
+    *(--kst) = 0x23;            /* DS */
+    *(--kst) = 0x23;            /* ES */
+    *(--kst) = 0x23;            /* FS */
+    *(--kst) = 0x23;            /* GS  ← saved_esp points here */
+    p->saved_esp = (unsigned int)kst;   /* = phys_kstack + PAGE_SIZE - 76 */
+}
+
+/*
+ * process_create — build a per-process page directory and load the binary.
+ * Works under any CR3: the binary and args are written through the direct map.
+ *
+ * Virtual layout in PDE[1] (base 0x400000):
+ *   VPN   0..63    binary  (64 × 4 KB = 256 KB)
+ *   VPN  64..767   heap    (unmapped initially, mapped on demand by SYS_SBRK)
+ *   VPN 768..983   mmap area (mapped page by page on #PF, see sys_mmap)
+ *   VPN 984..1015  thread stacks (8 slots × 4 pages, see sys_thread_create)
+ *   VPN 1016       guard page (never mapped)
+ *   VPN 1017..1022 stack   (one page at exec, grown on #PF by stack_fault)
+ *   VPN 1023       ARGS_BASE = 0x7FF000
+ *
+ * Only phys_frames[0]=PD and phys_frames[1]=PT are tracked here; p->resident
+ * counts the present PTEs.  process_free_user() frees the user pages region
+ * by region (binary + heap up to heap_break, thread stacks, stack).
+ */
+static struct process *process_create(const char *name, const char *args)
+{
+    int i;
+    struct process *p = process_alloc(name);
+    if (!p) return 0;
+    unsigned int *pt = (unsigned int *)p->phys_frames[1];
+
+    /* [1] Build initial ring-3 context frame on the kernel stack */
+    kstack_init(p, PROG_BASE, USER_STACK_TOP);
+
+    /* [2] Allocate 64 contiguous frames for binary (VPN 0–63); paging
+     * single pages out rarely frees a run, killing a process does */
+    unsigned int bin_phys = pmm_alloc_contiguous(64);
+    while (!bin_phys && oom_kill() == 0) bin_phys = pmm_alloc_contiguous(64);
+    if (!bin_phys) goto fail;
+    for (i = 0; i < 64; i++)
+        pt[i] = (bin_phys + (unsigned int)i * 0x1000) | 0x07;  /* P+RW+U */
+    p->resident = 64;
+
+    /* [3] Allocate the args page (VPN 1023) and the top stack page (VPN 1022);
+     * the rest of the stack is mapped as it grows */
+    for (i = 1022; i < 1024; i++) {
+        unsigned int f = user_frame_alloc(0);   /* no RSS limit: nothing to page out yet */
+        if (!f) goto fail;
+        pt[i] = f | 0x07;                                       /* P+RW+U */
+        p->resident++;
+    }
+
+    /* [4] Load binary into physical frames (through the direct map: they
+     * may sit in the 4–8 MB window).  Zero-fill bytes [n..PROG_MAX_SIZE) so
+     * the .bss section is properly zeroed (physical frames may carry stale
+     * data from previous processes). */
+    unsigned char *bin = P2V(bin_phys);
+    wb_flush_all();   /* the loader reads the disk, not the page cache */
+    int n = fat16_read_from_bin(name, bin, PROG_MAX_SIZE);
+    if (n <= 0) goto fail;
+    memset(bin + n, 0, PROG_MAX_SIZE - n);
+
+    /* [5] Copy args into the args page */
+    char *dst = P2V(pt[1023] & ~0xFFFu);
+    for (i = 0; i < ARGS_MAX - 1 && args[i]; i++) dst[i] = args[i];
+    dst[i] = '\0';
+
+    p->state = PROC_READY;
+    return p;
+
+fail:
+    process_abort(p);
+    return 0;
+}
+
+/* ============================================================
+ * mmap — files mapped into the user page table
+ *
+ * mmap() only reserves a range of the mmap area; each page is mapped on
+ * its first access (#PF).  MAP_SHARED maps the page-cache frame itself,
+ * pinned while mapped, so the process, read()/write() and every other
+ * mapping see the same bytes; pages the CPU marked dirty (PTE.D) are
+ * written back on munmap() and at exit.  MAP_PRIVATE maps a copy that
+ * is never written back.
+ * ============================================================ */
+
+static struct vma *vma_find(struct process *p, unsigned int addr)
+{
+    for (int i = 0; i < MMAP_MAX; i++) {
+        struct vma *v = &p->mmaps[i];
+        if (v->start && addr >= v->start && addr < v->start + v->pages * PAGE_SIZE)
+            return v;
+    }
+    return 0;
+}
+
+/* Map the page at addr if it lies in one of g_current's mappings.  0 = mapped. */
+static int mmap_fault(unsigned int addr, int write)
+{
+    struct process *mm = proc_owner(g_current);
+    struct vma *v = vma_find(mm, addr);
+    if (!v || v->shm || (write && !(v->flags & PROT_WRITE))) return -1;
+
+    unsigned int *pt  = (unsigned int *)g_current->phys_frames[1];
+    unsigned int  vpn = (addr - PROG_BASE) / PAGE_SIZE;
+    unsigned int  idx = (addr - v->start) / PAGE_SIZE;
+    if (pt[vpn] & 0x01) return -1;                      /* present: protection fault */
+    if (idx * PAGE_SIZE >= v->fn->size) return -1;      /* past the end of the file  */
+
+    struct cpage *c = pc_get(v->fn, idx, 1);
+    if (!c) return -1;
+    unsigned int rw = (v->flags & PROT_WRITE) ? 0x02 : 0;
+    if (v->flags & MAP_SHARED) {
+        c->mapped++;
+        pt[vpn] = (unsigned int)c->data | 0x05 | rw;   /* P+U (+RW) */
+    } else {
+        unsigned int fr = user_frame_alloc(mm);
+        if (!fr) return -1;
+        memcpy(P2V(fr), c->data, PAGE_SIZE);
+        pt[vpn] = fr | 0x05 | rw;                       /* P+U (+RW) */
+    }
+    mm->resident++;
+    return 0;
+}
+
+static int cow_fault(unsigned int addr);
+static int stack_fault(unsigned int addr);
+
+/* Fault in the paged-out, file-mapped and not yet grown stack pages of
+ * [addr, addr + len), and for a write break copy-on-write sharing, before
+ * the kernel touches them: a fault in the middle of a disk transfer into
+ * the buffer would start another one, and a COW page would take the data
+ * for both processes.  Returns -1 if the range runs past the user page
+ * table, where nothing is mapped, or a page of it is still not ready,
+ * e.g. evicted again to make room for a later one. */
+static int user_prefault(unsigned int addr, unsigned int len, int write)
+{
+    unsigned int top = PROG_BASE + 1024 * PAGE_SIZE;
+    if (!g_current || len == 0) return 0;
+    if (addr >= top || len > top - addr) return -1;
+    if (addr < PROG_BASE && len <= PROG_BASE - addr) return 0;
+    unsigned int *pt    = (unsigned int *)g_current->phys_frames[1];
+    unsigned int  start = (addr < PROG_BASE ? PROG_BASE : addr) & ~0xFFFu;
+    unsigned int  end   = addr + len;
+    unsigned int  va;
+    for (va = start; va < end; va += PAGE_SIZE) {
+        unsigned int *pte = &pt[(va - PROG_BASE) / PAGE_SIZE];
+        if (*pte & PTE_SWAP)
+            swap_fault(va);
+        else if (!(*pte & 0x01) && va >= MMAP_BASE && va < MMAP_END)
+            mmap_fault(va, write);
+        else if (!(*pte & 0x01))
+            stack_fault(va);                    /* -1 outside the stack range */
+        if (write && (*pte & 0x01) && (*pte & PTE_COW))
+            cow_fault(va);
+    }
+    for (va = start; va < end; va += PAGE_SIZE) {
+        unsigned int pte = pt[(va - PROG_BASE) / PAGE_SIZE];
+        if (!(pte & 0x01) || (write && (pte & PTE_COW))) return -1;
+    }
+    return 0;
+}
+
+/* Grow the stack down to the page at addr if it lies between STACK_LOW and
+ * the top.  The guard page below STACK_LOW is never mapped, so running off
+ * the end still faults.  0 = mapped. */
+static int stack_fault(unsigned int addr)
+{
+    if (addr < STACK_LOW || addr >= USER_STACK_TOP) return -1;
+    struct process *mm  = proc_owner(g_current);
+    unsigned int   *pt  = (unsigned int *)mm->phys_frames[1];
+    unsigned int    vpn = (addr - PROG_BASE) / PAGE_SIZE;
+    if (pt[vpn] & 0x01) return -1;                      /* present: protection fault */
+    unsigned int fr = user_frame_alloc(mm);
+    if (!fr) return -1;
+    memset(P2V(fr), 0, PAGE_SIZE);
+    pt[vpn] = fr | 0x07;                                /* P+RW+U */
+    mm->resident++;
+    return 0;
+}
+
+static void shm_unmap(struct process *p, struct vma *v);
+
+/*
+ * Tear down mapping v of process p.  Shared pages written through the
+ * mapping are marked dirty and the file is written back; private copies
+ * go back to the PMM.  Shared memory segments are detached (shm_unmap).
+ */
+static void vma_unmap(struct process *p, struct vma *v)
+{
+    unsigned int *pt    = (unsigned int *)p->phys_frames[1];
+    struct fnode *fn    = v->fn;
+    int           dirty = 0;
+
+    if (v->shm) { shm_unmap(p, v); return; }
+
+    for (unsigned int i = 0; i < v->pages; i++) {
+        unsigned int vpn = (v->start - PROG_BASE) / PAGE_SIZE + i;
+        unsigned int pte = pt[vpn];
+        if (!(pte & 0x01)) continue;
+        pt[vpn] = 0;
+        p->resident--;
+        if (!(v->flags & MAP_SHARED)) { pmm_free(pte & ~0xFFFu); continue; }
+
+        struct cpage *c = pc_find(fn, i);
+        if (!c) continue;
+        c->mapped--;
+        if ((pte & 0x40) && i * PAGE_SIZE < fn->size) {   /* PTE.D: written */
+            unsigned int n = fn->size - i * PAGE_SIZE;
+            if (n > PAGE_SIZE) n = PAGE_SIZE;
+            memset(c->data + n, 0, PAGE_SIZE - n);   /* past EOF */
+            if (c->dirty_lo == c->dirty_hi) c->dirty_tick = g_ticks;
+            c->dirty_lo = 0;
+            if (c->dirty_hi < n) c->dirty_hi = n;
+            dirty = 1;
+        }
+    }
+    if (dirty) wb_flush_fnode(fn);
+    fn->refs--;
+    v->start = 0;
+}
+
+/*
+ * Claim a free vma of p and the first range of the mmap area that fits
+ * pages.  Returns it with start/pages set (fn and shm cleared), or 0.
+ */
+static struct vma *vma_reserve(struct process *p, unsigned int pages)
+{
+    struct vma *v = 0;
+    for (int i = 0; i < MMAP_MAX && !v; i++)
+        if (!p->mmaps[i].start) v = &p->mmaps[i];
+    if (!v) return 0;
+
+    /* First fit: move past every mapping the candidate range overlaps */
+    unsigned int start = MMAP_BASE;
+    for (int i = 0; i < MMAP_MAX; i++) {
+        struct vma *w = &p->mmaps[i];
+        if (w->start && start < w->start + w->pages * PAGE_SIZE &&
+            w->start < start + pages * PAGE_SIZE) {
+            start = w->start + w->pages * PAGE_SIZE;
+            i = -1;   /* rescan from the first mapping */
+        }
+    }
+    if (start + pages * PAGE_SIZE > MMAP_END) return 0;
+
+    v->start = start;
+    v->pages = pages;
+    v->fn    = 0;
+    v->shm   = 0;
+    return v;
+}
+
+/*
+ * Map the first len bytes of file fd (0 = the whole file) into the mmap
+ * area.  flags: PROT_READ/PROT_WRITE plus exactly one of MAP_SHARED or
+ * MAP_PRIVATE.  Returns the address, or -1.
+ */
+static unsigned int sys_mmap(unsigned int fd, unsigned int len, int flags)
+{
+    struct file *f = fd_get(&proc_owner(g_current)->files, fd);
+    if (!f || f->pipe || !FILE_READABLE(f)) return (unsigned int)-1;
+    if (!(flags & MAP_SHARED) == !(flags & MAP_PRIVATE)) return (unsigned int)-1;
+    if ((flags & MAP_SHARED) && (flags & PROT_WRITE) && !FILE_WRITABLE(f))
+        return (unsigned int)-1;
+    if (len == 0) len = f->fn->size;
+    if (len == 0 || len > MMAP_END - MMAP_BASE) return (unsigned int)-1;
+
+    struct vma *v = vma_reserve(proc_owner(g_current), (len + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (!v) return (unsigned int)-1;
+    v->fn    = f->fn;
+    v->flags = flags;
+    f->fn->refs++;
+    return v->start;
+}
+
+/* Unmap the mapping that starts at addr.  Returns 0, or -1 if there is none. */
+static int sys_munmap(unsigned int addr)
+{
+    for (int i = 0; i < MMAP_MAX; i++) {
+        struct vma *v = &proc_owner(g_current)->mmaps[i];
+        if (!v->start || v->start != addr || v->shm) continue;
+        unsigned int pages = v->pages;
+        vma_unmap(proc_owner(g_current), v);
+        tlb_flush_range(addr, pages);
+        return 0;
+    }
+    return -1;
+}
+
+/* ============================================================
+ * Message passing — synchronous send / receive / reply by pid
+ *
+ * msg_send(pid, req, reply) copies the fixed-size request into the
+ * sender's PCB and blocks until the receiver has answered.  msg_receive()
+ * takes the oldest request addressed to the caller (blocking while there
+ * is none) and returns the sender's pid; msg_reply(pid, m) copies the
+ * answer into the sender's PCB and unblocks it.  Each side copies between
+ * its own user memory and a PCB, so no process touches another's address
+ * space.  Both send and reply hand the CPU straight to the partner
+ * (g_handoff): a round trip costs two context switches.
+ * ============================================================ */
+
+static unsigned int g_ipc_seq = 0;
+
+static struct process *proc_find(int pid)
+{
+    for (int i = 0; i < PROC_MAX_PROCS; i++)
+        if (g_procs[i].state != PROC_UNUSED && g_procs[i].pid == pid)
+            return &g_procs[i];
+    return 0;
+}
+
+/* Send req to pid and wait for its reply.  Returns 0, or -1 (no such
+ * process, or it exited before replying). */
+static int sys_msg_send(int pid, const struct msg *req, struct msg *reply)
+{
+    struct process *dst = proc_find(pid);
+    if (!dst || dst == g_current || dst->state == PROC_ZOMBIE) return -1;
+
+    memcpy(&g_current->ipc_msg, req, sizeof(struct msg));
+    g_current->ipc_peer  = pid;
+    g_current->ipc_seq   = ++g_ipc_seq;
+    g_current->ipc_state = IPC_SEND;
+    if (dst->ipc_state == IPC_RECV) wakeup(&dst->ipc_state);
+    g_handoff = dst;
+    while (g_current->ipc_state == IPC_SEND || g_current->ipc_state == IPC_REPLY)
+        sleep_on(&g_current->ipc_msg);
+
+    int done = g_current->ipc_state == IPC_DONE;
+    g_current->ipc_state = IPC_IDLE;
+    if (!done) return -1;
+    if (user_prefault((unsigned int)reply, sizeof(struct msg), 1) < 0) return -1;
+    memcpy(reply, &g_current->ipc_msg, sizeof(struct msg));
+    return 0;
+}
+
+/* Wait for a request; copy it to m and return the sender's pid. */
+static int sys_msg_receive(struct msg *m)
+{
+    for (;;) {
+        struct process *s = 0;
+        for (int i = 0; i < PROC_MAX_PROCS; i++) {
+            struct process *q = &g_procs[i];
+            if (q->state == PROC_UNUSED || q->ipc_state != IPC_SEND) continue;
+            if (q->ipc_peer != g_current->pid) continue;
+            if (!s || (int)(q->ipc_seq - s->ipc_seq) < 0) s = q;   /* oldest first */
+        }
+        if (s) {
+            if (user_prefault((unsigned int)m, sizeof(struct msg), 1) < 0) return -1;
+            memcpy(m, &s->ipc_msg, sizeof(struct msg));
+            s->ipc_state = IPC_REPLY;
+            return s->pid;
+        }
+        g_current->ipc_state = IPC_RECV;
+        sleep_on(&g_current->ipc_state);     /* woken by sys_msg_send() */
+        g_current->ipc_state = IPC_IDLE;
+    }
+}
+
+/* Answer the request received from pid.  Returns 0, or -1 if pid is not
+ * waiting for a reply from us. */
+static int sys_msg_reply(int pid, const struct msg *m)
+{
+    struct process *s = proc_find(pid);
+    if (!s || s->ipc_state != IPC_REPLY || s->ipc_peer != g_current->pid) return -1;
+    memcpy(&s->ipc_msg, m, sizeof(struct msg));
+    s->ipc_state = IPC_DONE;
+    wakeup(&s->ipc_msg);
+    g_handoff = s;
+    return 0;
+}
+
+/* p is going away: fail every send still waiting for p to receive or reply. */
+static void msg_abort(struct process *p)
+{
+    for (int i = 0; i < PROC_MAX_PROCS; i++) {
+        struct process *q = &g_procs[i];
+        if (q->state == PROC_UNUSED || q->ipc_peer != p->pid) continue;
+        if (q->ipc_state != IPC_SEND && q->ipc_state != IPC_REPLY) continue;
+        q->ipc_state = IPC_FAILED;
+        wakeup(&q->ipc_msg);
+    }
+}
+
+/* ============================================================
+ * Shared memory — segments of frames attached by key
+ *
+ * shmat(key, size, SHM_CREATE) creates a zeroed segment of up to
+ * SHM_PAGES_MAX frames under a non-zero key, or finds the existing one;
+ * every attach maps all of its frames read/write into a range of the
+ * mmap area.  The segment holds one reference on each frame and every
+ * attachment one more (pmm_ref), so a frame only goes back to the PMM
+ * when nobody maps it.  The segment itself, and with it its key, goes
+ * away when the last attachment is detached (shmdt or exit).
+ * ============================================================ */
+
+struct shm {
+    unsigned int key;                     /* 0 = slot free       */
+    unsigned int pages;
+    int          attached;                /* vmas mapping it     */
+    unsigned int frames[SHM_PAGES_MAX];
+};
+
+static struct shm g_shm[SHM_MAX];
+
+/* Detach v from its segment; the last detach frees the segment. */
+static void shm_unmap(struct process *p, struct vma *v)
+{
+    unsigned int *pt  = (unsigned int *)p->phys_frames[1];
+    struct shm   *shm = v->shm;
+    for (unsigned int i = 0; i < v->pages; i++) {
+        unsigned int vpn = (v->start - PROG_BASE) / PAGE_SIZE + i;
+        if (pt[vpn] & 0x01) { pmm_free(pt[vpn] & ~0xFFFu); p->resident--; }
+        pt[vpn] = 0;
+    }
+    v->start = 0;
+    v->shm   = 0;
+    if (--shm->attached > 0) return;
+    for (unsigned int i = 0; i < shm->pages; i++)
+        pmm_free(shm->frames[i]);
+    shm->key = 0;
+}
+
+/* Attach (and with SHM_CREATE, create) segment key.  Returns the address, or -1. */
+static unsigned int sys_shmat(unsigned int key, unsigned int size, int flags)
+{
+    if (!key) return (unsigned int)-1;
+    struct shm *shm = 0, *free_slot = 0;
+    for (int i = 0; i < SHM_MAX; i++) {
+        if (g_shm[i].key == key) shm = &g_shm[i];
+        else if (!g_shm[i].key && !free_slot) free_slot = &g_shm[i];
+    }
+    unsigned int pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    if (!shm) {
+        if (!(flags & SHM_CREATE) || !free_slot) return (unsigned int)-1;
+        if (pages == 0 || pages > SHM_PAGES_MAX) return (unsigned int)-1;
+        shm = free_slot;
+        for (shm->pages = 0; shm->pages < pages; shm->pages++) {
+            unsigned int fr = pmm_alloc_kernel();   /* zeroed from syscall context */
+            if (!fr) {
+                while (shm->pages) pmm_free(shm->frames[--shm->pages]);
+                return (unsigned int)-1;
+            }
+            memset((void *)fr, 0, PAGE_SIZE);
+            shm->frames[shm->pages] = fr;
+        }
+        shm->key      = key;
+        shm->attached = 0;
+    } else if (pages > shm->pages || shm->attached >= SHM_ATTACH_MAX) {
+        return (unsigned int)-1;
+    }
+
+    struct process *mm = proc_owner(g_current);
+    struct vma *v = vma_reserve(mm, shm->pages);
+    if (!v) {
+        if (!shm->attached) {   /* just created: nobody else knows it */
+            for (unsigned int i = 0; i < shm->pages; i++) pmm_free(shm->frames[i]);
+            shm->key = 0;
+        }
+        return (unsigned int)-1;
+    }
+    v->shm   = shm;
+    v->flags = PROT_READ | PROT_WRITE | MAP_SHARED;
+    shm->attached++;
+
+    unsigned int *pt = (unsigned int *)mm->phys_frames[1];
+    for (unsigned int i = 0; i < shm->pages; i++) {
+        pmm_ref(shm->frames[i]);
+        pt[(v->start - PROG_BASE) / PAGE_SIZE + i] = shm->frames[i] | 0x07;   /* P+RW+U */
+    }
+    mm->resident += shm->pages;
+    return v->start;
+}
+
+/* Detach the segment attached at addr.  Returns 0, or -1 if there is none. */
+static int sys_shmdt(unsigned int addr)
+{
+    for (int i = 0; i < MMAP_MAX; i++) {
+        struct vma *v = &proc_owner(g_current)->mmaps[i];
+        if (!v->start || v->start != addr || !v->shm) continue;
+        unsigned int pages = v->pages;
+        shm_unmap(proc_owner(g_current), v);
+        tlb_flush_range(addr, pages);
+        return 0;
+    }
+    return -1;
+}
+
+/* ============================================================
+ * fork — copy-on-write duplicate of the current process
+ *
+ * The child gets its own PD, PT and kernel stack, but no copies of user
+ * pages: every private page (binary, heap, stack, MAP_PRIVATE copies)
+ * is mapped into both page tables read-only with PTE_COW set, and the
+ * PMM counts the extra owner.  The first write from either side faults
+ * (CR0.WP makes kernel writes from syscalls fault too) and cow_fault()
+ * gives the writer its own copy — or, once the other side has copied or
+ * exited, simply makes the page writable again.  Shared memory stays
+ * shared; MAP_SHARED file pages are left for the child to fault in.
+ * ============================================================ */
+
+/* Resolve a write to a copy-on-write page.  Returns 0, or -1 if addr is
+ * not COW (a real protection fault) or no frame is left. */
+static int cow_fault(unsigned int addr)
+{
+    if (addr < PROG_BASE || addr >= PROG_BASE + 1024 * PAGE_SIZE) return -1;
+    unsigned int *pt  = (unsigned int *)g_current->phys_frames[1];
+    unsigned int  vpn = (addr - PROG_BASE) / PAGE_SIZE;
+    unsigned int  pte = pt[vpn];
+    if (!(pte & 0x01) || !(pte & PTE_COW)) return -1;
+
+    unsigned int frame = pte & ~0xFFFu;
+    if (pmm_shared(frame)) {
+        unsigned int copy = user_frame_alloc(proc_owner(g_current));
+        if (!copy) return -1;
+        memcpy(P2V(copy), P2V(frame), PAGE_SIZE);
+        pmm_free(frame);                 /* drop our reference */
+        frame = copy;
+    }
+    pt[vpn] = frame | (pte & 0xFFFu & ~PTE_COW) | 0x02;   /* +RW */
+    tlb_flush_range(addr & ~0xFFFu, 1);
+    return 0;
+}
+
+/* Map parent page vpn into child as well, write-protecting it on both sides. */
+static void cow_share(unsigned int *ppt, unsigned int *cpt, unsigned int vpn)
+{
+    unsigned int pte = ppt[vpn];
+    if (pte & 0x02) pte = (pte & ~0x02u) | PTE_COW;
+    ppt[vpn] = cpt[vpn] = pte;
+    pmm_ref(pte & ~0xFFFu);
+}
+
+/* cow_share() the present pages among VPNs [from, to) of ppt with child. */
+static void cow_range(struct process *child, unsigned int *ppt,
+                      unsigned int from, unsigned int to)
+{
+    unsigned int *cpt = (unsigned int *)child->phys_frames[1];
+    for (unsigned int vpn = from; vpn < to; vpn++) {
+        if (ppt[vpn] & PTE_SWAP) {               /* both name the slot */
+            cpt[vpn] = ppt[vpn];
+            swap_refs[ppt[vpn] >> 12]++;
+            child->swapped++;
+        }
+        if (!(ppt[vpn] & 0x01)) continue;
+        cow_share(ppt, cpt, vpn);
+        child->resident++;
+    }
+}
+
+/* Duplicate g_current; r is its syscall frame.  Returns the child's pid, or -1. */
+static int sys_fork(struct registers *r)
+{
+    struct process *parent = g_current;       /* the forking thread      */
+    struct process *mm     = proc_owner(parent);  /* its address space */
+    for (int i = 0; i < MMAP_MAX; i++)
+        if (mm->mmaps[i].start && mm->mmaps[i].shm &&
+            mm->mmaps[i].shm->attached >= SHM_ATTACH_MAX) return -1;
+
+    struct process *child = process_alloc(parent->name);
+    if (!child) return -1;
+    if (fd_inherit(&child->files, &mm->files, mm->files.cap) < 0) {
+        process_abort(child);
+        return -1;
+    }
+
+    /* Binary, heap and stack; of the thread stacks only the forking
+     * thread's, whose slot stays taken in the child */
+    unsigned int *ppt = (unsigned int *)parent->phys_frames[1];
+    unsigned int *cpt = (unsigned int *)child->phys_frames[1];
+    cow_range(child, ppt, 0, heap_end_vpn(mm));
+    cow_range(child, ppt, STACK_VPN, 1024);
+    if (parent->owner) {
+        unsigned int vpn = (THREAD_STACKS - PROG_BASE) / PAGE_SIZE +
+                           (unsigned int)parent->stack_slot * (THREAD_STACK / PAGE_SIZE);
+        cow_range(child, ppt, vpn, vpn + THREAD_STACK / PAGE_SIZE);
+        child->thread_slots = 1u << parent->stack_slot;
+    }
+    for (int i = 0; i < MMAP_MAX; i++) {
+        struct vma *v = &mm->mmaps[i], *w = &child->mmaps[i];
+        if (!v->start) continue;
+        unsigned int vpn0 = (v->start - PROG_BASE) / PAGE_SIZE;
+        *w = *v;
+        if (v->shm) {
+            v->shm->attached++;
+            for (unsigned int j = 0; j < v->pages; j++) {
+                cpt[vpn0 + j] = ppt[vpn0 + j];
+                pmm_ref(ppt[vpn0 + j] & ~0xFFFu);
+            }
+            child->resident += v->pages;
+            continue;
+        }
+        v->fn->refs++;
+        if (v->flags & MAP_SHARED) continue;  /* the child faults the cache pages in */
+        cow_range(child, ppt, vpn0, vpn0 + v->pages);
+    }
+    __asm__ volatile("mov %0, %%cr3" :: "r"(parent->cr3) : "memory");  /* now read-only */
+
+    /* The child resumes from the same syscall frame, with EAX = 0 */
+    struct registers *cr = (struct registers *)(child->phys_kstack + PAGE_SIZE - 76);
+    memcpy(cr, r, 76);   /* struct registers + user ESP and SS */
+    cr->eax          = 0;
+    child->saved_esp = (unsigned int)cr;
+
+    if (fpu_owner == parent) {           /* live in the FPU: save a copy */
+        if (fpu_fxsr) {
+            __asm__ volatile ("fxsave %0" : "=m"(child->fpu_state));
+        } else {                         /* fnsave reinitialises the FPU */
+            __asm__ volatile ("fnsave %0" : "=m"(child->fpu_state));
+            __asm__ volatile ("frstor %0" :: "m"(child->fpu_state));
+        }
+        child->fpu_used = 1;
+    } else if (parent->fpu_used) {
+        memcpy(child->fpu_state, parent->fpu_state, sizeof(child->fpu_state));
+        child->fpu_used = 1;
+    }
+
+    child->heap_break    = mm->heap_break;
+    child->is_background = 1;   /* reaped with waitpid(), like exec_bg */
+    child->state         = PROC_READY;
+    return child->pid;
+}
+
+/* ============================================================
+ * Threads — more PCBs running in one address space
+ *
+ * A thread is a PCB with its own pid (the tid), kernel stack and FPU
+ * state whose owner field points at the process it was created in: it
+ * runs on the owner's CR3 and uses the owner's files, mappings and heap
+ * (proc_owner()), and is scheduled like any other process.  Its user
+ * stack is one of THREAD_MAX slots just below the main stack, each with
+ * an unmapped guard page at the bottom.  exit() in a thread ends only
+ * that thread, which stays a zombie until thread_join(); when the main
+ * thread exits, the remaining threads go with it (thread_kill_all).
+ *
+ * futex_wait(addr, val) sleeps on a user address as long as it still
+ * holds val, futex_wake(addr, n) wakes up to n sleepers of the same
+ * process: the building blocks for user-space locks (bin/os.h).
+ * ============================================================ */
+
+/* Unmap the user stack in slot of mm and give the slot back. */
+static void thread_stack_free(struct process *mm, int slot)
+{
+    unsigned int *pt  = (unsigned int *)mm->phys_frames[1];
+    unsigned int  vpn = (THREAD_STACKS + (unsigned int)slot * THREAD_STACK - PROG_BASE) / PAGE_SIZE;
+    for (unsigned int i = 1; i < THREAD_STACK / PAGE_SIZE; i++) {   /* [0] = guard */
+        if (pt[vpn + i] & 0x01) { pmm_free(pt[vpn + i] & ~0xFFFu); mm->resident--; }
+        pt[vpn + i] = 0;
+    }
+    mm->thread_slots &= ~(1u << slot);
+}
+
+/* Start a thread of the current process at user address start, which is
+ * called as start(fn, arg).  Returns the tid, or -1. */
+static int sys_thread_create(unsigned int fn, unsigned int arg, unsigned int start)
+{
+    struct process *mm = proc_owner(g_current);
+    int slot;
+    for (slot = 0; slot < THREAD_MAX; slot++)
+        if (!(mm->thread_slots & (1u << slot))) break;
+    if (slot == THREAD_MAX) return -1;
+
+    struct process *t = proc_slot(mm->name);
+    if (!t) return -1;
+    t->phys_kstack = pmm_alloc_kernel();
+    if (!t->phys_kstack) return -1;   /* the slot is still PROC_UNUSED */
+
+    mm->thread_slots |= 1u << slot;
+    unsigned int *pt   = (unsigned int *)mm->phys_frames[1];
+    unsigned int  base = THREAD_STACKS + (unsigned int)slot * THREAD_STACK;
+    unsigned int  vpn  = (base - PROG_BASE) / PAGE_SIZE;
+    for (unsigned int i = 1; i < THREAD_STACK / PAGE_SIZE; i++) {
+        unsigned int pa = user_frame_alloc(mm);
+        if (!pa) {
+            thread_stack_free(mm, slot);
+            pmm_free(t->phys_kstack);
+            t->phys_kstack = 0;
+            return -1;
+        }
+        pt[vpn + i] = pa | 0x07;                     /* P+RW+U */
+        mm->resident++;
+    }
+
+    /* start(fn, arg) with a null return address: through the user mapping,
+     * the frames may sit in the 4–8 MB window */
+    unsigned int *usp = (unsigned int *)(base + THREAD_STACK) - 3;
+    usp[0] = 0;
+    usp[1] = fn;
+    usp[2] = arg;
+
+    t->owner          = mm;
+    t->stack_slot     = slot;
+    t->cr3            = mm->cr3;
+    t->phys_frames[0] = mm->phys_frames[0];   /* not owned: n_frames stays 0 */
+    t->phys_frames[1] = mm->phys_frames[1];
+    t->is_background  = mm->is_background;
+    kstack_init(t, start, (unsigned int)usp);
+    t->state = PROC_READY;
+    return t->pid;
+}
+
+/* Terminate the current thread (not the main one).  Like process_exit_bg(),
+ * returns the ESP of the next process; does not return if none is runnable. */
+static unsigned int thread_exit(struct registers *r, int code)
+{
+    struct process *t = g_current;
+    thread_stack_free(t->owner, t->stack_slot);
+    tlb_flush_range(THREAD_STACKS + (unsigned int)t->stack_slot * THREAD_STACK,
+                    THREAD_STACK / PAGE_SIZE);
+    msg_abort(t);
+    fpu_release(t);
+    t->exit_code = code;
+    t->state     = PROC_ZOMBIE;
+    wakeup(t);                           /* thread_join() sleeps on the thread */
+
+    unsigned int esp = schedule(r);
+    if (esp) return esp;
+    __asm__ volatile("sti");
+    for (;;) __asm__ volatile("hlt");
+}
+
+/* Wait for thread tid of the current process to exit and reap it.
+ * Returns tid, or -1 if it is no such thread (or another join got it). */
+static int sys_thread_join(int tid, int *status)
+{
+    struct process *t = proc_find(tid);
+    if (!t || t == g_current || t->owner != proc_owner(g_current)) return -1;
+    while (t->state != PROC_ZOMBIE) {
+        sleep_on(t);
+        if (t->state == PROC_UNUSED || t->pid != tid) return -1;
+    }
+    if (status) *status = t->exit_code;
+    process_reap(t);
+    return tid;
+}
+
+/* Discard every thread of p, running or not; process_free_user(p) frees
+ * their stacks (thread_slots). */
+static void thread_kill_all(struct process *p)
+{
+    for (int i = 0; i < PROC_MAX_PROCS; i++) {
+        struct process *t = &g_procs[i];
+        if (t->state == PROC_UNUSED || t->owner != p) continue;
+        msg_abort(t);
+        fpu_release(t);
+        if (t->phys_kstack) pmm_free(t->phys_kstack);
+        t->phys_kstack = 0;
+        t->owner       = 0;
+        t->state       = PROC_UNUSED;
+    }
+}
+
+/* Check that a futex word is a mapped, aligned user address. */
+static int futex_ok(unsigned int addr)
+{
+    if ((addr & 3) || addr < PROG_BASE || addr >= USER_STACK_TOP) return 0;
+    user_prefault(addr, 4, 0);
+    unsigned int *pt = (unsigned int *)g_current->phys_frames[1];
+    return pt[(addr - PROG_BASE) / PAGE_SIZE] & 0x01;
+}
+
+/* Sleep until futex_wake(addr) unless *addr != val.  Returns 0, or -1. */
+static int sys_futex_wait(unsigned int addr, unsigned int val)
+{
+    if (!futex_ok(addr) || *(volatile unsigned int *)addr != val) return -1;
+    sleep_on((void *)addr);              /* IF=0 since the check: no lost wake */
+    return 0;
+}
+
+/* Wake up to n threads of the current process waiting on addr.  Returns
+ * how many were woken. */
+static int sys_futex_wake(unsigned int addr, int n)
+{
+    struct process *mm = proc_owner(g_current);
+    int woken = 0;
+    for (int i = 0; i < PROC_MAX_PROCS && woken < n; i++) {
+        struct process *p = &g_procs[i];
+        if (p->state != PROC_BLOCKED || p->wait_chan != (void *)addr ||
+            proc_owner(p) != mm) continue;
+        p->state = PROC_READY;
+        woken++;
+    }
+    return woken;
+}
+
+/*
+ * process_free_user — release the address space of process p.
+ * Frees the user pages region by region — mappings, binary + heap up to
+ * heap_break, thread stacks in use, stack — instead of scanning the whole
+ * PT, then frees the PT and PD.  The kernel stack is kept: an exiting
+ * process is still running on it.
+ * Must not be called while running on p's page directory.
+ */
+static void process_free_user(struct process *p)
+{
+    fpu_release(p);
+    if (p->n_frames < 2) return;   /* already released */
+    for (int i = 0; i < MMAP_MAX; i++)  /* page-cache and shm frames are not ours alone */
+        if (p->mmaps[i].start) vma_unmap(p, &p->mmaps[i]);
+    pt_free_range(p, 0, heap_end_vpn(p));
+    for (int slot = 0; slot < THREAD_MAX; slot++)
+        if (p->thread_slots & (1u << slot)) thread_stack_free(p, slot);
+    pt_free_range(p, STACK_VPN, 1024);
+    pmm_free(p->phys_frames[0]);   /* PD          */
+    pmm_free(p->phys_frames[1]);   /* PT          */
+    p->n_frames = 0;
+}
+
+/*
+ * process_orphan_children — detach p's children before p goes away.
+ * Zombie children are reaped at once; live ones are reaped by
+ * process_create() after they exit.
+ */
+static void process_orphan_children(struct process *p)
+{
+    for (int i = 0; i < PROC_MAX_PROCS; i++) {
+        struct process *c = &g_procs[i];
+        if (c->state == PROC_UNUSED || c == p || c->parent_pid != p->pid || c->owner) continue;
+        c->parent_pid = 0;
+        if (c->state == PROC_ZOMBIE)
+            process_reap(c);
+    }
+}
+
+/* process_reap — free the kernel stack of a zombie and release its slot. */
+static void process_reap(struct process *p)
+{
+    fd_table_release(&p->files);
+    process_free_user(p);
+    if (p->phys_kstack) pmm_free(p->phys_kstack);
+    p->phys_kstack = 0;
+    p->state       = PROC_UNUSED;
+}
+
+/*
+ * process_destroy — release all physical memory owned by process p
+ * (address space and kernel stack).  Used for foreground children, which
+ * have finished running on their kernel stack by the time SYS_EXEC cleans up.
+ * Must not be called while running on p's page directory.
+ */
+static void process_destroy(struct process *p)
+{
+    thread_kill_all(p);
+    msg_abort(p);
+    process_orphan_children(p);
+    process_reap(p);
+}
+
+/*
+ * process_zombify — end background process p with exit code code.
+ * Its threads, files and frames are released immediately; only the PCB
+ * slot and the kernel stack remain until the parent reaps it with
+ * waitpid() (or, for orphans, until process_create() needs the slot).
+ * Must not be called while running on p's page directory.
+ */
+static void process_zombify(struct process *p, int code)
+{
+    p->exit_code = code;
+    thread_kill_all(p);
+    msg_abort(p);
+    process_orphan_children(p);
+    fd_table_release(&p->files);
+    process_free_user(p);
+    p->cr3   = (unsigned int)page_dir;   /* zombie idles in the kernel map */
+    p->state = PROC_ZOMBIE;
+
+    /* Wake the parent if it is blocked in waitpid() */
+    for (int i = 0; i < PROC_MAX_PROCS; i++)
+        if (g_procs[i].state != PROC_UNUSED && g_procs[i].pid == p->parent_pid)
+            wakeup(&g_procs[i]);
+}
+
+/*
+ * process_exit_bg — terminate the current background process.
+ * Returns the ESP of the next process; does not return if none is runnable.
+ */
+static unsigned int process_exit_bg(struct registers *r, int code)
+{
+    struct process *p = g_current;
+    vga_check_and_restore_textmode();
+    fat16_set_cwd_cluster((unsigned short)p->saved_cwd_cluster);
+
+    __asm__ volatile("mov %0, %%cr3" :: "r"(page_dir) : "memory");
+    process_zombify(p, code);
+
+    unsigned int esp = schedule(r);
+    if (esp) return esp;
+    /* Nothing runnable: idle until IRQ0 finds someone (never saves our context) */
+    __asm__ volatile("sti");
+    for (;;) __asm__ volatile("hlt");
+}
+
+/*
+ * oom_kill — memory is full and nothing can be paged out: kill the
+ * process with the largest resident set, which exits with 137.  Only a
+ * background process is killed; if the largest one is the caller itself,
+ * the shell, a foreground job or waits for one, nobody is and the
+ * allocation fails.  Returns 0 if a process was killed.
+ */
+static int oom_kill(void)
+{
+    struct process *self = g_current ? proc_owner(g_current) : 0;
+    struct process *victim = 0;
+    unsigned int    most   = self ? self->resident : 0;
+    for (int i = 0; i < PROC_MAX_PROCS; i++) {
+        struct process *p = &g_procs[i];
+        if (p->state == PROC_UNUSED || p->state == PROC_ZOMBIE || p->owner ||
+            p->n_frames < 2 || p->resident <= most) continue;
+        most   = p->resident;
+        victim = (p->is_background && p->state != PROC_WAITING) ? p : 0;
+    }
+    if (!victim) return -1;
+
+    char num[12];
+    print("\nOut of memory: killed ");
+    print(victim->name);
+    uint_to_str(victim->resident * 4, num);
+    print(" ("); print(num); print(" kB)\n");
+    process_zombify(victim, 137);
+    return 0;
+}
+
+/*
+ * sys_waitpid — reap a zombie child of g_current's process.
+ * pid > 0 waits for that child, pid == -1 for any child.
+ * Returns the child's pid, 0 with WNOHANG if none has exited yet,
+ * or -1 if there is no matching child.
+ */
+static int sys_waitpid(int pid, int *status, int options)
+{
+    for (;;) {
+        int found = 0;
+        for (int i = 0; i < PROC_MAX_PROCS; i++) {
+            struct process *c = &g_procs[i];
+            if (c->state == PROC_UNUSED || c == g_current || c->owner) continue;
+            if (c->parent_pid != proc_owner(g_current)->pid) continue;
+            if (pid != -1 && c->pid != pid) continue;
+            found = 1;
+            if (c->state == PROC_ZOMBIE) {
+                int cpid = c->pid;
+                if (status) *status = c->exit_code;
+                process_reap(c);
+                return cpid;
+            }
+        }
+        if (!found)              return -1;
+        if (options & WNOHANG)   return 0;
+        sleep_on(proc_owner(g_current));   /* woken by process_exit_bg() */
+    }
+}
+
+/* Directory listing buffer used by SYS_READDIR — already in the user layout */
+#define LS_MAX_ENTRIES 64
+
+static struct direntry ls_buf[LS_MAX_ENTRIES];
+static int             ls_count;
+
+static void ls_collect(const char *name, unsigned int size, int is_dir)
+{
+    if (ls_count >= LS_MAX_ENTRIES) return;
+    int i = 0;
+    while (name[i] && i < 12) { ls_buf[ls_count].name[i] = name[i]; i++; }
+    ls_buf[ls_count].name[i] = '\0';
+    ls_buf[ls_count].size   = size;
+    ls_buf[ls_count].is_dir = is_dir;
+    ls_count++;
+}
+
+static unsigned int sc_exit(struct registers *r)
+{
+    if (g_current->owner) return thread_exit(r, (int)r->ebx);   /* only this thread */
+    g_current->exit_code = (int)r->ebx;
+    if (g_current->is_background) {
+        /* Background process: free its memory now, become a zombie
+         * until the parent reaps it, and switch away immediately. */
+        return process_exit_bg(r, (int)r->ebx);
+    }
+    /* Foreground process: longjmp back to SYS_EXEC (or kernel_main).
+     * cli ensures IRQ0 doesn't fire between the ESP swap and the ret;
+     * sti is done in SYS_EXEC after g_current is updated. */
+    g_exit_code = (int)r->ebx;
+    __asm__ volatile(
+        "cli\n"
+        "mov %0, %%esp\n"
+        "pop %%edi\n"
+        "pop %%esi\n"
+        "pop %%ebx\n"
+        "pop %%ebp\n"
+        "ret\n"
+        :
+        : "r"(exec_ret_esp)
+        : "memory"
+    );
+    return 0;   /* not reached */
+}
+
+static unsigned int sc_write(struct registers *r)
+{
+    r->eax = (unsigned int)sys_write(&proc_owner(g_current)->files, r->ebx, (const char *)r->ecx, r->edx);
+    return 0;
+}
+
+static unsigned int sc_read(struct registers *r)
+{
+    r->eax = (unsigned int)sys_read(&proc_owner(g_current)->files, r->ebx, (char *)r->ecx, r->edx);
+    return 0;
+}
+
+static unsigned int sc_open(struct registers *r)
+{
+    char path[PATH_MAX];
+    if (user_path(path, (const char *)r->ebx) < 0) { r->eax = (unsigned int)-1; return 0; }
+    r->eax = (unsigned int)sys_open(&proc_owner(g_current)->files, path, (int)r->ecx);
+    return 0;
+}
+
+static unsigned int sc_close(struct registers *r)
+{
+    r->eax = (unsigned int)sys_close(&proc_owner(g_current)->files, r->ebx);
+    return 0;
+}
+
+static unsigned int sc_lseek(struct registers *r)
+{
+    r->eax = (unsigned int)sys_lseek(&proc_owner(g_current)->files, r->ebx, (int)r->ecx, (int)r->edx);
+    return 0;
+}
+
+static unsigned int sc_iostat(struct registers *r)
+{
+    r->eax = (unsigned int)sys_iostat((struct iostat *)r->ebx);
+    return 0;
+}
+
+static unsigned int sc_mmap(struct registers *r)
+{
+    r->eax = sys_mmap(r->ebx, r->ecx, (int)r->edx);
+    return 0;
+}
+
+static unsigned int sc_munmap(struct registers *r)
+{
+    r->eax = (unsigned int)sys_munmap(r->ebx);
+    return 0;
+}
+
+static unsigned int sc_pipe(struct registers *r)
+{
+    r->eax = (unsigned int)sys_pipe(&proc_owner(g_current)->files, (int *)r->ebx);
+    return 0;
+}
+
+static unsigned int sc_dup2(struct registers *r)
+{
+    r->eax = (unsigned int)sys_dup2(&proc_owner(g_current)->files, r->ebx, r->ecx);
+    return 0;
+}
+
+static unsigned int sc_shmat(struct registers *r)
+{
+    r->eax = sys_shmat(r->ebx, r->ecx, (int)r->edx);
+    return 0;
+}
+
+static unsigned int sc_shmdt(struct registers *r)
+{
+    r->eax = (unsigned int)sys_shmdt(r->ebx);
+    return 0;
+}
+
+static unsigned int sc_getchar(struct registers *r)
+{
+    char c = 0;
+    /* Enable interrupts so the scheduler can run background processes
+     * while we are waiting for keyboard input. */
+    __asm__ volatile("sti");
+    while (!c) {
+        idle_hlt();
+        c = kbd_getchar();
+    }
+    __asm__ volatile("cli");
+    r->eax = (unsigned int)(unsigned char)c;
+    return 0;
+}
+
+static unsigned int sc_setpos(struct registers *r)
+{
+    int row = (int)r->ebx;
+    int col = (int)r->ecx;
+    if (row < 0) row = 0;
+    if (row >= VGA_ROWS) row = VGA_ROWS - 1;
+    if (col < 0) col = 0;
+    if (col >= VGA_COLS) col = VGA_COLS - 1;
+    cursor_row = row;
+    cursor_col = col;
+    vga_update_hw_cursor();
+    r->eax = 0;
+    return 0;
+}
+
+static unsigned int sc_clrscr(struct registers *r)
+{
+    vga_clear();
+    r->eax = 0;
+    return 0;
+}
+
+static unsigned int sc_getchar_nonblock(struct registers *r)
+{
+    r->eax = (unsigned int)(unsigned char)kbd_getchar();
+    return 0;
+}
+
+static unsigned int sc_readdir(struct registers *r)
+{
+    struct direntry *user_buf = (struct direntry *)r->ebx;
+    int max = (int)r->ecx;
+    ls_count = 0;
+    wb_flush_all();   /* directory entries must show the cached sizes */
+    if (fat16_listdir(ls_collect) < 0) { r->eax = (unsigned int)-1; return 0; }
+    int rn = ls_count < max ? ls_count : max;
+    if (rn > 0) memcpy(user_buf, ls_buf, (unsigned int)rn * sizeof(struct direntry));
+    r->eax = (unsigned int)rn;
+    return 0;
+}
+
+static unsigned int sc_unlink(struct registers *r)
+{
+    char path[PATH_MAX];
+    if (user_path(path, (const char *)r->ebx) < 0) { r->eax = (unsigned int)-1; return 0; }
+    r->eax = (unsigned int)sys_unlink(path);
+    return 0;
+}
+
+static unsigned int sc_mkdir(struct registers *r)
+{
+    char path[PATH_MAX];
+    if (user_path(path, (const char *)r->ebx) < 0) { r->eax = (unsigned int)-1; return 0; }
+    r->eax = (unsigned int)fat16_mkdir(path);
+    return 0;
+}
+
+static unsigned int sc_rename(struct registers *r)
+{
+    char src[PATH_MAX], dst[PATH_MAX];
+    if (user_path(src, (const char *)r->ebx) < 0 || user_path(dst, (const char *)r->ecx) < 0) {
+        r->eax = (unsigned int)-1;
+        return 0;
+    }
+    r->eax = (unsigned int)fat16_rename(src, dst);
+    return 0;
+}
+
+static unsigned int sc_chdir(struct registers *r)
+{
+    char path[PATH_MAX];
+    if (user_path(path, (const char *)r->ebx) < 0) { r->eax = (unsigned int)-1; return 0; }
+    r->eax = (unsigned int)fat16_chdir(path);
+    return 0;
+}
+
+static unsigned int sc_getpos(struct registers *r)
+{
+    r->eax = (unsigned int)(cursor_row * 256 + cursor_col);
+    return 0;
+}
 
-    /* For #PF (INT 14): decode the error code into human-readable flags */
-    if (r->int_no == 14) {
-        unsigned int e = r->err_code;
-        int col = 2;
-        ps_str(vga, 17, col, "#PF:", PANIC_HDR); col += 5;
-        ps_str(vga, 17, col, (e & 1)  ? "PROT-VIOL"   : "NOT-PRESENT", PANIC_BODY); col += 12;
-        ps_str(vga, 17, col, (e & 2)  ? "WRITE"       : "READ",        PANIC_BODY); col +=  6;
-        ps_str(vga, 17, col, (e & 4)  ? "USER"        : "KERNEL",      PANIC_BODY); col +=  7;
-        ps_str(vga, 17, col, (e & 16) ? "INSTR-FETCH" : "DATA",        PANIC_BODY);
-    }
+static unsigned int sc_panic(struct registers *r)
+{
+    panic_screen((const char *)r->ebx, r);
+    for (;;) __asm__ volatile("hlt");
+    return 0;   /* not reached */
+}
 
-    /* Current process */
-    ps_str(vga, 19,  1, "Current Process", PANIC_HDR);
-    if (g_current) {
-        int col = 2;
-        ps_str(vga, 20, col, "PID ",  PANIC_HDR); col += 4;
-        col = ps_dec(vga, 20, col, (unsigned int)g_current->pid, PANIC_BODY);
-        col += 2;
-        ps_str(vga, 20, col, "Name ", PANIC_HDR); col += 5;
-        ps_str(vga, 20, col, g_current->name, PANIC_BODY);
-        col += 16;
-        ps_str(vga, 20, col, "State ", PANIC_HDR); col += 6;
-        ps_str(vga, 20, col, proc_state_name(g_current->state), PANIC_BODY);
-        col += 8;
-        ps_str(vga, 20, col, "BG ", PANIC_HDR); col += 3;
-        ps_str(vga, 20, col, g_current->is_background ? "yes" : "no", PANIC_BODY);
-    } else {
-        ps_str(vga, 20, 2, "(no process)", PANIC_BODY);
-    }
+/* Set limit which of the caller's process to kb (0 = none), or with
+ * kb < 0 only read it.  A lower RSS limit takes effect at the next page
+ * the process needs.  Returns the previous limit in kB, or -1. */
+static int sys_setlimit(int which, int kb)
+{
+    struct process *mm  = proc_owner(g_current);
+    unsigned int   *lim = which == LIMIT_RSS  ? &mm->rss_limit  :
+                          which == LIMIT_HEAP ? &mm->heap_limit : 0;
+    if (!lim) return -1;
+    int old = (int)(*lim * 4);
+    if (kb >= 0) *lim = ((unsigned int)kb + 3) / 4;   /* round up to pages */
+    return old;
+}
 
-    /* Serial dump */
-    serial_print("[PANIC] "); serial_print(msg); serial_putchar('\n');
-    serial_print("[PANIC] EAX="); serial_hex(r->eax);
-    serial_print(" EBX=");        serial_hex(r->ebx);
-    serial_print(" ECX=");        serial_hex(r->ecx);
-    serial_print(" EDX=");        serial_hex(r->edx); serial_putchar('\n');
-    serial_print("[PANIC] ESI="); serial_hex(r->esi);
-    serial_print(" EDI=");        serial_hex(r->edi);
-    serial_print(" EBP=");        serial_hex(r->ebp);
-    serial_print(" ESP=");        serial_hex(r->esp); serial_putchar('\n');
-    serial_print("[PANIC] EIP="); serial_hex(r->eip);
-    serial_print(" EFLAGS=");     serial_hex(r->eflags);
-    serial_print(" CS=");         serial_hex(r->cs);
-    serial_print(" DS=");         serial_hex(r->ds);  serial_putchar('\n');
-    serial_print("[PANIC] ES=");  serial_hex(r->es);
-    serial_print(" FS=");         serial_hex(r->fs);
-    serial_print(" GS=");         serial_hex(r->gs);  serial_putchar('\n');
-    serial_print("[PANIC] CR0="); serial_hex(cr0);
-    serial_print(" CR2=");        serial_hex(cr2);
-    serial_print(" CR3=");        serial_hex(cr3);
-    serial_print(" CR4=");        serial_hex(cr4);    serial_putchar('\n');
-    serial_print("[PANIC] INT="); serial_hex(r->int_no);
-    serial_print(" ERR=");        serial_hex(r->err_code);
-    serial_print(" TICKS=");      serial_hex(g_ticks); serial_putchar('\n');
-    if (g_current) {
-        serial_print("[PANIC] PID=");
-        serial_hex((unsigned int)g_current->pid);
-        serial_print(" NAME="); serial_print(g_current->name);
-        serial_print(" STATE="); serial_print(proc_state_name(g_current->state));
-        serial_putchar('\n');
+/* Fill buf with up to max processes.  Returns the number filled, or -1. */
+static int sys_procinfo(struct procinfo *buf, int max)
+{
+    if (max < 0) return -1;
+    int n = 0;
+    for (int i = 0; i < PROC_MAX_PROCS && n < max; i++) {
+        struct process *p = &g_procs[i];
+        if (p->state == PROC_UNUSED || p->owner) continue;
+        struct procinfo *pi = &buf[n++];
+        int live = p->n_frames >= 2;              /* zombies hold no pages */
+        pi->pid           = p->pid;
+        pi->parent_pid    = p->parent_pid;
+        pi->threads       = 0;
+        for (int j = 0; j < PROC_MAX_PROCS; j++)
+            if (g_procs[j].state != PROC_UNUSED && g_procs[j].owner == p) pi->threads++;
+        pi->rss_kb        = live ? p->resident * 4 : 0;
+        pi->swap_kb       = live ? p->swapped  * 4 : 0;
+        pi->heap_kb       = (p->heap_break - HEAP_BASE + 1023) / 1024;
+        pi->rss_limit_kb  = p->rss_limit  * 4;
+        pi->heap_limit_kb = p->heap_limit * 4;
+        switch (p->state) {
+        case PROC_ZOMBIE:  pi->state = 'Z'; break;
+        case PROC_WAITING: pi->state = 'W'; break;
+        case PROC_SLEEPING:
+        case PROC_BLOCKED: pi->state = 'S'; break;
+        default:           pi->state = 'R'; break;
+        }
+        memcpy(pi->name, p->name, sizeof(pi->name));
     }
+    return n;
 }
 
-/* Round-robin: find next READY or RUNNING process (never returns g_current). */
-static struct process *pick_next_process(void)
+static unsigned int sc_meminfo(struct registers *r)
 {
-    if (!g_current) return 0;
-    int cur = (int)(g_current - g_procs);
-    int i;
-    for (i = 1; i < PROC_MAX_PROCS; i++) {
-        int j = (cur + i) % PROC_MAX_PROCS;
-        proc_state_t s = g_procs[j].state;
-        if (s == PROC_READY || s == PROC_RUNNING)
-            return &g_procs[j];
+    struct meminfo *info = (struct meminfo *)r->ebx;
+    unsigned int total_frames = pmm_total();
+    unsigned int used_frames  = pmm_count_used();
+    info->phys_total_kb = total_frames * 4;
+    info->phys_used_kb  = used_frames  * 4;
+    info->phys_free_kb  = (total_frames - used_frames) * 4;
+
+    /* Count active processes and their mapped virtual pages */
+    int n_procs = 0;
+    unsigned int virt_used_pages = 0;
+    for (int mi = 0; mi < PROC_MAX_PROCS; mi++) {
+        /* Zombies hold no memory beyond their kernel stack: not counted */
+        if (g_procs[mi].state == PROC_UNUSED ||
+            g_procs[mi].state == PROC_ZOMBIE) continue;
+        if (g_procs[mi].owner) continue;   /* threads: counted with their process */
+        n_procs++;
+        if (g_procs[mi].n_frames >= 2)
+            virt_used_pages += g_procs[mi].resident;
     }
+    info->n_procs       = n_procs;
+    info->virt_total_kb = (unsigned int)(n_procs * 4096); /* 4 MB per proc */
+    info->virt_used_kb  = virt_used_pages * 4;
+    info->virt_free_kb  = info->virt_total_kb - info->virt_used_kb;
+    info->swap_total_kb = swap_ready ? SWAP_SLOTS * 4 : 0;
+    info->swap_used_kb  = swap_used * 4;
+    r->eax = 0;
     return 0;
 }
 
-/*
- * process_create — build a per-process page directory and load the binary.
- * Must be called while CR3 = page_dir (kernel identity map).
- *
- * Virtual layout in PDE[1] (base 0x400000):
- *   VPN   0..63    binary  (64 × 4 KB = 256 KB)
- *   VPN  64..1015  heap    (unmapped initially, mapped on demand by SYS_SBRK)
- *   VPN 1016..1022 stack   (7 × 4 KB = 28 KB)
- *   VPN 1020       ARGS_BASE = 0x7FC000  (stack_frames[4])
- *
- * Only phys_frames[0]=PD and phys_frames[1]=PT are tracked here.
- * All user pages (binary, stack, heap) are freed by scanning the PT
- * in process_destroy().
- */
-static struct process *process_create(const char *name, const char *args)
+static unsigned int sc_sbrk(struct registers *r)
 {
-    int i, slot = -1;
-    for (i = 0; i < PROC_MAX_PROCS; i++) {
-        /* Lazily reuse ZOMBIE slots */
-        if (g_procs[i].state == PROC_ZOMBIE) {
-            process_destroy(&g_procs[i]);
-            g_procs[i].state = PROC_UNUSED;
-        }
-        if (g_procs[i].state == PROC_UNUSED) { slot = i; break; }
+    /*
+     * sbrk(n): map n more bytes of heap, return old break, or -1 on failure.
+     * Heap lives at HEAP_BASE..HEAP_MAX-1 (VPN 64..767 in the user PT).
+     * The PT frame comes from pmm_alloc_kernel(), so it is reachable
+     * through the current page directory: no CR3 switch, and new pages
+     * need no TLB flush.
+     */
+    struct process *mm = proc_owner(g_current);   /* threads share the heap */
+    int sbrk_n = (int)r->ebx;
+    if (sbrk_n == 0) { r->eax = mm->heap_break; return 0; }
+    if (sbrk_n < 0 || (unsigned int)sbrk_n > HEAP_MAX - mm->heap_break) {
+        r->eax = (unsigned int)-1; return 0;
+    }
+    unsigned int old_brk = mm->heap_break;
+    unsigned int new_brk = old_brk + (unsigned int)sbrk_n;
+    if (mm->heap_limit &&
+        (new_brk - HEAP_BASE + PAGE_SIZE - 1) / PAGE_SIZE > mm->heap_limit) {
+        r->eax = (unsigned int)-1; return 0;
     }
-    if (slot < 0) return 0;
 
-    struct process *p = &g_procs[slot];
-    p->n_frames      = 0;
-    p->pid           = slot + 1;
-    p->heap_break    = HEAP_BASE;
-    p->phys_kstack   = 0;
-    p->is_background = 0;
-    {   /* copy name, truncate to 15 chars */
-        int ni = 0;
-        while (name[ni] && ni < 15) { p->name[ni] = name[ni]; ni++; }
-        p->name[ni] = '\0';
+    unsigned int *sbrk_pt = (unsigned int *)mm->phys_frames[1];
+    unsigned int vpn;
+    int oom = 0;
+    for (vpn = heap_end_vpn(mm); vpn < (new_brk - PROG_BASE + 0xFFFu) / 0x1000; vpn++) {
+        unsigned int pa = user_frame_alloc(mm);
+        if (!pa) { oom = 1; break; }
+        sbrk_pt[vpn] = pa | 0x07;             /* P+RW+U */
+        mm->resident++;
     }
+    /* Out of frames: give back what this call mapped, so that exactly
+     * the pages below heap_break stay mapped (see heap_end_vpn) */
+    if (oom) {
+        unsigned int first = heap_end_vpn(mm);
+        pt_free_range(mm, first, vpn);
+        tlb_flush_range(PROG_BASE + first * PAGE_SIZE, vpn - first);
+        r->eax = (unsigned int)-1;
+        return 0;
+    }
+    mm->heap_break = new_brk;
+    r->eax = old_brk;
+    return 0;
+}
 
-    /* Declare pt early so the fail: block can reference it safely */
-    unsigned int *pt = (unsigned int *)0;
+static unsigned int sc_exec(struct registers *r)
+{
+    char name[13], args[ARGS_MAX];
+    int xi;
+
+    /* [A] Copy name/args from parent's user space (current CR3) */
+    const char *src_name = (const char *)r->ebx;
+    for (xi = 0; xi < 12 && src_name[xi]; xi++) name[xi] = src_name[xi];
+    name[xi] = '\0';
+    const char *src_args = (const char *)r->ecx;
+    for (xi = 0; xi < ARGS_MAX - 1 && src_args[xi]; xi++) args[xi] = src_args[xi];
+    args[xi] = '\0';
+
+    /* EDX bit 0: 0 = foreground, 1 = background */
+    int bg = (int)(r->edx & 1);
+    /* A foreground child takes over the caller's process: not from a thread */
+    if (!bg && g_current && g_current->owner) { r->eax = (unsigned int)-1; return 0; }
+
+    unsigned short saved_cwd = fat16_get_cwd_cluster();
+
+    /* [B] Create child process (loads binary + builds page tables); no
+     * CR3 switch, the direct map reaches the child's frames */
+    struct process *child = process_create(name, args);
+    if (!child) {
+        fat16_set_cwd_cluster(saved_cwd);
+        r->eax = (unsigned int)-1;
+        return 0;
+    }
 
-    /* [1] Allocate page directory */
-    unsigned int pd_phys = pmm_alloc();
-    if (!pd_phys) return 0;
-    p->phys_frames[0] = pd_phys;
-    p->n_frames       = 1;
-    p->cr3            = pd_phys;
+    child->is_background = bg;
+    if (g_current) fd_inherit(&child->files, &proc_owner(g_current)->files, FD_STDOUT + 1);
 
-    /* [2] Allocate user page table; clear it immediately */
-    unsigned int pt_phys = pmm_alloc();
-    if (!pt_phys) goto fail;
-    p->phys_frames[1] = pt_phys;
-    p->n_frames       = 2;
-    pt                = (unsigned int *)pt_phys;
-    for (i = 0; i < 1024; i++) pt[i] = 0;
-
-    /* [3] Allocate kernel stack and build initial ring-3 context frame.
-     * The frame mirrors what isr_common pushes when preempting a ring-3 process,
-     * allowing the scheduler to start this process via context switch on first run. */
-    unsigned int kstack_phys = pmm_alloc();
-    if (!kstack_phys) goto fail;
-    p->phys_kstack = kstack_phys;
-    {
-        unsigned int *kst = (unsigned int *)(kstack_phys + PAGE_SIZE);
-        *(--kst) = 0x23;            /* user SS  (ring-3 data selector)   */
-        *(--kst) = USER_STACK_TOP;  /* user ESP                          */
-        *(--kst) = 0x3200;          /* EFLAGS: IF=1, IOPL=3              */
-        *(--kst) = 0x1B;            /* user CS  (ring-3 code selector)   */
-        *(--kst) = PROG_BASE;       /* user EIP (program entry point)    */
-        *(--kst) = 0;               /* err_code (dummy)                  */
-        *(--kst) = 0;               /* int_no   (dummy)                  */
-        /* pusha order on stack: EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI */
-        *(--kst) = 0;               /* EAX */
-        *(--kst) = 0;               /* ECX */
-        *(--kst) = 0;               /* EDX */
-        *(--kst) = 0;               /* EBX */
-        *(--kst) = 0;               /* ESP (ignored by popa) */
-        *(--kst) = 0;               /* EBP */
-        *(--kst) = 0;               /* ESI */
-        *(--kst) = 0;               /* EDI */
-        *(--kst) = 0x23;            /* DS */
-        *(--kst) = 0x23;            /* ES */
-        *(--kst) = 0x23;            /* FS */
-        *(--kst) = 0x23;            /* GS  ← saved_esp points here */
-        p->saved_esp = (unsigned int)kst;   /* = kstack_phys + PAGE_SIZE - 76 */
+    if (bg) {
+        /* [BG] Background: child is READY, return PID to shell immediately.
+         * IRQ0 will schedule the child on its next turn. */
+        child->state = PROC_READY;
+        fat16_set_cwd_cluster(saved_cwd);
+        r->eax = (unsigned int)child->pid;
+        return 0;
     }
-    p->saved_cwd_cluster = fat16_get_cwd_cluster();
 
-    /* [4] Allocate 64 contiguous frames for binary (VPN 0–63) */
-    unsigned int bin_phys = pmm_alloc_contiguous(64);
-    if (!bin_phys) goto fail;
-    for (i = 0; i < 64; i++)
-        pt[i] = (bin_phys + (unsigned int)i * 0x1000) | 0x07;  /* P+RW+U */
+    /* [C] Foreground: record parent context in child PCB */
+    child->parent_cr3         = g_current ? g_current->cr3 : (unsigned int)page_dir;
+    child->saved_exec_ret_esp = exec_ret_esp;
+    child->state              = PROC_RUNNING;
+    struct process *parent    = g_current;
+    parent->state             = PROC_WAITING;   /* scheduler skips waiting parent */
+    g_current                 = child;
+    g_exit_code               = 0;
+    fpu_switch_to(child);
+
+    /* [D] Switch to child page directory and run */
+    __asm__ volatile("mov %0, %%cr3" :: "r"(child->cr3) : "memory");
+    exec_run(PROG_BASE, USER_STACK_TOP, child->phys_kstack + PAGE_SIZE);
+
+    /* [E] Child finished — SYS_EXIT did cli before longjmping here */
+    exec_ret_esp         = child->saved_exec_ret_esp;
+    unsigned int par_cr3 = child->parent_cr3;
+    int          ecode   = g_exit_code;
+
+    /* [F] Cleanup: back on the parent's page directory, destroy child */
+    __asm__ volatile("mov %0, %%cr3" :: "r"(par_cr3) : "memory");
+    process_destroy(child);
+
+    /* Update g_current before sti so IRQ0 sees correct state */
+    g_current     = parent;
+    parent->state = PROC_RUNNING;
+    tss_set_ring0_stack(parent->phys_kstack + PAGE_SIZE);
+    fpu_switch_to(parent);
+    __asm__ volatile("sti");   /* re-enable interrupts */
+
+    /* [G] Restore VGA text mode and cwd */
+    vga_check_and_restore_textmode();
+    fat16_set_cwd_cluster(saved_cwd);
+
+    r->eax = (unsigned int)ecode;
+    return 0;
+}
 
-    /* [5] Allocate 7 frames for stack+args (VPN 1016–1022) */
-    for (i = 0; i < 7; i++) {
-        unsigned int f = pmm_alloc();
-        if (!f) goto fail;
-        pt[1016 + i] = f | 0x07;                                /* P+RW+U */
-    }
-    /* VPN 1020 = ARGS_BASE = stack frame 4 (1020 - 1016) */
+static unsigned int sc_sleep(struct registers *r)
+{
+    /* sleep(ms): block the current process for at least ms milliseconds.
+     * The PIT fires at PIT_HZ; each tick is 1000/PIT_HZ ms.
+     * The process spins on hlt (with interrupts enabled) until the timer
+     * ISR sets its state back to PROC_RUNNING. */
+    unsigned int ms = r->ebx;
+    unsigned int ticks = (ms * (unsigned int)PIT_HZ + 999u) / 1000u;
+    if (ticks == 0) ticks = 1;
+    g_current->wakeup_tick = g_ticks + ticks;
+    g_current->state = PROC_SLEEPING;
+    __asm__ volatile("sti");
+    while (g_current->state == PROC_SLEEPING)
+        idle_hlt();
+    r->eax = 0;
+    return 0;
+}
 
-    /* [6] Load binary into physical frames (identity-mapped in kernel page_dir).
-     * Zero-fill bytes [n..PROG_MAX_SIZE) so the .bss section is properly zeroed
-     * (physical frames may carry stale data from previous processes). */
-    int n = fat16_read_from_bin(name, (unsigned char *)bin_phys, PROG_MAX_SIZE);
-    if (n <= 0) goto fail;
-    {
-        unsigned char *base = (unsigned char *)bin_phys;
-        for (i = n; i < PROG_MAX_SIZE; i++) base[i] = 0;
-    }
+static unsigned int sc_yield(struct registers *r)
+{
+    r->eax = 0;
+    return schedule(r);
+}
 
-    /* [7] Copy args into the args page (identity-mapped) */
-    char *dst = (char *)(pt[1020] & ~0xFFFu);
-    for (i = 0; i < ARGS_MAX - 1 && args[i]; i++) dst[i] = args[i];
-    dst[i] = '\0';
+static unsigned int sc_waitpid(struct registers *r)
+{
+    r->eax = (unsigned int)sys_waitpid((int)r->ebx, (int *)r->ecx, (int)r->edx);
+    return 0;
+}
 
-    /* [8] Build page directory */
-    unsigned int *pd = (unsigned int *)pd_phys;
-    for (i = 0; i < 1024; i++) pd[i] = 0;
-    pd[0] = (unsigned int)pt_kernel | 0x07;   /* shared kernel PT, 0–4 MB */
-    pd[1] = pt_phys | 0x07;                   /* user PT                   */
-    /* PDE[2]–PDE[511]: 4 MB PSE supervisor-only identity (kernel write access) */
-    for (i = 2; i < 512; i++)
-        pd[i] = (unsigned int)(i << 22) | 0x83;  /* P+RW+PS, U=0 */
+static unsigned int sc_send(struct registers *r)
+{
+    r->eax = (unsigned int)sys_msg_send((int)r->ebx, (const struct msg *)r->ecx,
+                                        (struct msg *)r->edx);
+    return 0;
+}
 
-    p->state = PROC_READY;
-    return p;
+static unsigned int sc_receive(struct registers *r)
+{
+    r->eax = (unsigned int)sys_msg_receive((struct msg *)r->ebx);
+    return 0;
+}
 
-fail:
-    /* Free any user pages already mapped in the PT */
-    if (p->n_frames >= 2) {
-        for (i = 0; i < 1024; i++)
-            if (pt[i] & 0x01) pmm_free(pt[i] & ~0xFFFu);
-        pmm_free(p->phys_frames[1]);         /* PT itself */
-    }
-    if (p->n_frames >= 1) pmm_free(p->phys_frames[0]);  /* PD */
-    if (p->phys_kstack)   pmm_free(p->phys_kstack);
-    p->n_frames    = 0;
-    p->phys_kstack = 0;
-    p->state       = PROC_UNUSED;
+/* A successful reply switches to the sender right away (direct switch) */
+static unsigned int sc_reply(struct registers *r)
+{
+    r->eax = (unsigned int)sys_msg_reply((int)r->ebx, (const struct msg *)r->ecx);
+    return r->eax == 0 ? schedule(r) : 0;
+}
+
+static unsigned int sc_fork(struct registers *r)
+{
+    r->eax = (unsigned int)sys_fork(r);
     return 0;
 }
 
-/*
- * process_destroy — release all physical memory owned by process p.
- * Scans the user PT to find and free all mapped user pages (binary, stack,
- * heap), then frees the PT, PD, and kernel stack.
- * Must be called while CR3 = page_dir (kernel identity map).
- */
-static void process_destroy(struct process *p)
+static unsigned int sc_thread(struct registers *r)
 {
-    int vpn;
-    unsigned int *pt = (unsigned int *)p->phys_frames[1];
-    for (vpn = 0; vpn < 1024; vpn++)
-        if (pt[vpn] & 0x01) pmm_free(pt[vpn] & ~0xFFFu);
-    pmm_free(p->phys_frames[0]);   /* PD          */
-    pmm_free(p->phys_frames[1]);   /* PT          */
-    if (p->phys_kstack) pmm_free(p->phys_kstack);
-    p->n_frames    = 0;
-    p->phys_kstack = 0;
-    p->state       = PROC_UNUSED;
+    r->eax = (unsigned int)sys_thread_create(r->ebx, r->ecx, r->edx);
+    return 0;
 }
 
-/* Directory listing buffer used by SYS_READDIR */
-#define LS_MAX_ENTRIES 64
+static unsigned int sc_join(struct registers *r)
+{
+    r->eax = (unsigned int)sys_thread_join((int)r->ebx, (int *)r->ecx);
+    return 0;
+}
 
-struct ls_entry {
-    char         name[13];
-    unsigned int size;
-    int          is_dir;
-};
+static unsigned int sc_futex_wait(struct registers *r)
+{
+    r->eax = (unsigned int)sys_futex_wait(r->ebx, r->ecx);
+    return 0;
+}
 
-static struct ls_entry ls_buf[LS_MAX_ENTRIES];
-static int             ls_count;
+static unsigned int sc_futex_wake(struct registers *r)
+{
+    r->eax = (unsigned int)sys_futex_wake(r->ebx, (int)r->ecx);
+    return 0;
+}
 
-static void ls_collect(const char *name, unsigned int size, int is_dir)
+static unsigned int sc_pageout(struct registers *r)
 {
-    if (ls_count >= LS_MAX_ENTRIES) return;
-    int i = 0;
-    while (name[i] && i < 12) { ls_buf[ls_count].name[i] = name[i]; i++; }
-    ls_buf[ls_count].name[i] = '\0';
-    ls_buf[ls_count].size   = size;
-    ls_buf[ls_count].is_dir = is_dir;
-    ls_count++;
+    r->eax = (unsigned int)sys_pageout(r->ebx, r->ecx);
+    return 0;
 }
 
-static void syscall_dispatch(struct registers *r)
+static unsigned int sc_setlimit(struct registers *r)
 {
-    switch (r->eax) {
-    case SYS_EXIT:
-        g_current->exit_code = (int)r->ebx;
-        if (g_current->is_background) {
-            /* Background process: restore VGA/CWD, mark zombie, yield via hlt.
-             * IRQ0 will context-switch away on the next tick. */
-            vga_check_and_restore_textmode();
-            fat16_set_cwd_cluster((unsigned short)g_current->saved_cwd_cluster);
-            g_current->state = PROC_ZOMBIE;
-            __asm__ volatile("sti");
-            for (;;) __asm__ volatile("hlt");
-        } else {
-            /* Foreground process: longjmp back to SYS_EXEC (or kernel_main).
-             * cli ensures IRQ0 doesn't fire between the ESP swap and the ret;
-             * sti is done in SYS_EXEC after g_current is updated. */
-            g_exit_code = (int)r->ebx;
-            __asm__ volatile(
-                "cli\n"
-                "mov %0, %%esp\n"
-                "pop %%edi\n"
-                "pop %%esi\n"
-                "pop %%ebx\n"
-                "pop %%ebp\n"
-                "ret\n"
-                :
-                : "r"(exec_ret_esp)
-                : "memory"
-            );
-        }
-        break;
-    case SYS_WRITE:
-        r->eax = (unsigned int)sys_write(r->ebx, (const char *)r->ecx, r->edx);
-        break;
-    case SYS_READ:
-        r->eax = (unsigned int)sys_read(r->ebx, (char *)r->ecx, r->edx);
-        break;
-    case SYS_OPEN:
-        r->eax = (unsigned int)sys_open((const char *)r->ebx, (int)r->ecx);
-        break;
-    case SYS_CLOSE:
-        r->eax = (unsigned int)sys_close(r->ebx);
-        break;
-    case SYS_GETCHAR: {
-        char c = 0;
-        /* Enable interrupts so the scheduler can run background processes
-         * while we are waiting for keyboard input. */
-        __asm__ volatile("sti");
-        while (!c) {
-            __asm__ volatile("hlt");
-            c = kbd_getchar();
-        }
-        __asm__ volatile("cli");
-        r->eax = (unsigned int)(unsigned char)c;
-        break;
-    }
-    case SYS_SETPOS: {
-        int row = (int)r->ebx;
-        int col = (int)r->ecx;
-        if (row < 0) row = 0;
-        if (row >= VGA_ROWS) row = VGA_ROWS - 1;
-        if (col < 0) col = 0;
-        if (col >= VGA_COLS) col = VGA_COLS - 1;
-        cursor_row = row;
-        cursor_col = col;
-        vga_update_hw_cursor();
-        r->eax = 0;
-        break;
-    }
-    case SYS_CLRSCR:
-        vga_clear();
-        r->eax = 0;
-        break;
-    case SYS_GETCHAR_NONBLOCK:
-        r->eax = (unsigned int)(unsigned char)kbd_getchar();
-        break;
-    case SYS_READDIR: {
-        struct direntry *user_buf = (struct direntry *)r->ebx;
-        int max = (int)r->ecx;
-        ls_count = 0;
-        if (fat16_listdir(ls_collect) < 0) { r->eax = (unsigned int)-1; break; }
-        int rn = ls_count < max ? ls_count : max;
-        for (int ri = 0; ri < rn; ri++) {
-            int j;
-            for (j = 0; j < 12 && ls_buf[ri].name[j]; j++)
-                user_buf[ri].name[j] = ls_buf[ri].name[j];
-            user_buf[ri].name[j] = '\0';
-            user_buf[ri].size   = ls_buf[ri].size;
-            user_buf[ri].is_dir = ls_buf[ri].is_dir;
-        }
-        r->eax = (unsigned int)rn;
-        break;
-    }
-    case SYS_UNLINK:
-        r->eax = (unsigned int)fat16_delete((const char *)r->ebx);
-        break;
-    case SYS_MKDIR:
-        r->eax = (unsigned int)fat16_mkdir((const char *)r->ebx);
-        break;
-    case SYS_RENAME:
-        r->eax = (unsigned int)fat16_rename((const char *)r->ebx, (const char *)r->ecx);
-        break;
-    case SYS_CHDIR:
-        r->eax = (unsigned int)fat16_chdir((const char *)r->ebx);
-        break;
-    case SYS_GETPOS:
-        r->eax = (unsigned int)(cursor_row * 256 + cursor_col);
-        break;
-    case SYS_PANIC:
-        panic_screen((const char *)r->ebx, r);
-        for (;;) __asm__ volatile("hlt");
-        break;
-    case SYS_MEMINFO: {
-        struct meminfo *info = (struct meminfo *)r->ebx;
-        unsigned int total_frames = pmm_total();
-        unsigned int used_frames  = pmm_count_used();
-        info->phys_total_kb = total_frames * 4;
-        info->phys_used_kb  = used_frames  * 4;
-        info->phys_free_kb  = (total_frames - used_frames) * 4;
-
-        /* Count active processes and their mapped virtual pages */
-        int n_procs = 0;
-        unsigned int virt_used_pages = 0;
-        for (int mi = 0; mi < PROC_MAX_PROCS; mi++) {
-            if (g_procs[mi].state == PROC_UNUSED) continue;
-            n_procs++;
-            /* phys_frames[1] = user page table (identity-mapped in 0–4MB) */
-            if (g_procs[mi].n_frames >= 2) {
-                unsigned int *pt = (unsigned int *)g_procs[mi].phys_frames[1];
-                for (int pj = 0; pj < 1024; pj++)
-                    if (pt[pj] & 0x01) virt_used_pages++;
-            }
-        }
-        info->n_procs       = n_procs;
-        info->virt_total_kb = (unsigned int)(n_procs * 4096); /* 4 MB per proc */
-        info->virt_used_kb  = virt_used_pages * 4;
-        info->virt_free_kb  = info->virt_total_kb - info->virt_used_kb;
-        r->eax = 0;
-        break;
-    }
-    case SYS_SBRK: {
-        /*
-         * sbrk(n): map n more bytes of heap, return old break, or -1 on failure.
-         * Heap lives at HEAP_BASE..HEAP_MAX-1 (VPN 64..1015 in the user PT).
-         * Switch to kernel page_dir so we can safely write to the process PT
-         * regardless of where the PT frame sits in physical memory.
-         */
-        int sbrk_n = (int)r->ebx;
-        if (sbrk_n == 0) { r->eax = g_current->heap_break; break; }
-        if (sbrk_n < 0 || (unsigned int)sbrk_n > HEAP_MAX - g_current->heap_break) {
-            r->eax = (unsigned int)-1; break;
-        }
-        unsigned int old_brk = g_current->heap_break;
-        unsigned int new_brk = old_brk + (unsigned int)sbrk_n;
-
-        /* Switch to kernel page_dir for safe PT access */
-        __asm__ volatile("mov %0, %%cr3" :: "r"(page_dir) : "memory");
-
-        unsigned int *sbrk_pt = (unsigned int *)g_current->phys_frames[1];
-        unsigned int va;
-        int oom = 0;
-        for (va = old_brk & ~0xFFFu; va < new_brk; va += 0x1000) {
-            unsigned int vpn = (va - PROG_BASE) / 0x1000;
-            if (sbrk_pt[vpn] & 0x01) continue;   /* already mapped */
-            unsigned int pa = pmm_alloc();
-            if (!pa) { oom = 1; break; }
-            sbrk_pt[vpn] = pa | 0x07;             /* P+RW+U */
-        }
+    r->eax = (unsigned int)sys_setlimit((int)r->ebx, (int)r->ecx);
+    return 0;
+}
 
-        /* Switch back to process page_dir (TLB flush picks up new mappings) */
-        __asm__ volatile("mov %0, %%cr3" :: "r"(g_current->cr3) : "memory");
-
-        if (oom) { r->eax = (unsigned int)-1; break; }
-        g_current->heap_break = new_brk;
-        r->eax = old_brk;
-        break;
-    }
-    case SYS_EXEC: {
-        char name[13], args[ARGS_MAX];
-        int xi;
-
-        /* [A] Copy name/args from parent's user space (current CR3) */
-        const char *src_name = (const char *)r->ebx;
-        for (xi = 0; xi < 12 && src_name[xi]; xi++) name[xi] = src_name[xi];
-        name[xi] = '\0';
-        const char *src_args = (const char *)r->ecx;
-        for (xi = 0; xi < ARGS_MAX - 1 && src_args[xi]; xi++) args[xi] = src_args[xi];
-        args[xi] = '\0';
-
-        /* EDX bit 0: 0 = foreground, 1 = background */
-        int bg = (int)(r->edx & 1);
-
-        unsigned short saved_cwd = fat16_get_cwd_cluster();
-
-        /* [B] Switch to kernel page_dir (identity map needed for process_create) */
-        __asm__ volatile("mov %0, %%cr3" :: "r"(page_dir) : "memory");
-
-        /* [C] Create child process (loads binary + builds page tables) */
-        struct process *child = process_create(name, args);
-        if (!child) {
-            unsigned int par_cr3c = g_current ? g_current->cr3 : (unsigned int)page_dir;
-            __asm__ volatile("mov %0, %%cr3" :: "r"(par_cr3c) : "memory");
-            fat16_set_cwd_cluster(saved_cwd);
-            r->eax = (unsigned int)-1;
-            break;
-        }
+static unsigned int sc_procinfo(struct registers *r)
+{
+    r->eax = (unsigned int)sys_procinfo((struct procinfo *)r->ebx, (int)r->ecx);
+    return 0;
+}
+
+static unsigned int sc_getpid(struct registers *r)
+{
+    r->eax = (unsigned int)proc_owner(g_current)->pid;
+    return 0;
+}
 
-        child->is_background = bg;
+static unsigned int sc_sysstat(struct registers *r)
+{
+    r->eax = (unsigned int)sys_sysstat((struct sysstat_entry *)r->ebx, (int)r->ecx);
+    return 0;
+}
 
-        if (bg) {
-            /* [BG] Background: child is READY, return PID to shell immediately.
-             * IRQ0 will schedule the child on its next turn. */
-            child->state = PROC_READY;
-            __asm__ volatile("mov %0, %%cr3" :: "r"(g_current->cr3) : "memory");
-            fat16_set_cwd_cluster(saved_cwd);
-            r->eax = (unsigned int)child->pid;
-            break;
-        }
+/*
+ * Syscall table, indexed by EAX.  Each handler stores its result in r->eax
+ * and returns 0, or the saved ESP of another process to switch to.
+ */
+typedef unsigned int (*syscall_fn)(struct registers *r);
+
+static const syscall_fn syscall_table[NR_SYSCALLS] = {
+    [SYS_EXIT]             = sc_exit,
+    [SYS_WRITE]            = sc_write,
+    [SYS_READ]             = sc_read,
+    [SYS_OPEN]             = sc_open,
+    [SYS_CLOSE]            = sc_close,
+    [SYS_GETCHAR]          = sc_getchar,
+    [SYS_SETPOS]           = sc_setpos,
+    [SYS_CLRSCR]           = sc_clrscr,
+    [SYS_GETCHAR_NONBLOCK] = sc_getchar_nonblock,
+    [SYS_READDIR]          = sc_readdir,
+    [SYS_UNLINK]           = sc_unlink,
+    [SYS_MKDIR]            = sc_mkdir,
+    [SYS_RENAME]           = sc_rename,
+    [SYS_EXEC]             = sc_exec,
+    [SYS_CHDIR]            = sc_chdir,
+    [SYS_GETPOS]           = sc_getpos,
+    [SYS_PANIC]            = sc_panic,
+    [SYS_MEMINFO]          = sc_meminfo,
+    [SYS_SBRK]             = sc_sbrk,
+    [SYS_SLEEP]            = sc_sleep,
+    [SYS_YIELD]            = sc_yield,
+    [SYS_WAITPID]          = sc_waitpid,
+    [SYS_GETPID]           = sc_getpid,
+    [SYS_SYSSTAT]          = sc_sysstat,
+    [SYS_LSEEK]            = sc_lseek,
+    [SYS_IOSTAT]           = sc_iostat,
+    [SYS_MMAP]             = sc_mmap,
+    [SYS_MUNMAP]           = sc_munmap,
+    [SYS_PIPE]             = sc_pipe,
+    [SYS_DUP2]             = sc_dup2,
+    [SYS_SHMAT]            = sc_shmat,
+    [SYS_SHMDT]            = sc_shmdt,
+    [SYS_SEND]             = sc_send,
+    [SYS_RECEIVE]          = sc_receive,
+    [SYS_REPLY]            = sc_reply,
+    [SYS_FORK]             = sc_fork,
+    [SYS_THREAD]           = sc_thread,
+    [SYS_JOIN]             = sc_join,
+    [SYS_FUTEX_WAIT]       = sc_futex_wait,
+    [SYS_FUTEX_WAKE]       = sc_futex_wake,
+    [SYS_PAGEOUT]          = sc_pageout,
+    [SYS_SETLIMIT]         = sc_setlimit,
+    [SYS_PROCINFO]         = sc_procinfo,
+};
 
-        /* [D] Foreground: record parent context in child PCB */
-        child->parent_cr3         = g_current ? g_current->cr3 : (unsigned int)page_dir;
-        child->saved_exec_ret_esp = exec_ret_esp;
-        child->state              = PROC_RUNNING;
-        struct process *parent    = g_current;
-        parent->state             = PROC_WAITING;   /* scheduler skips waiting parent */
-        g_current                 = child;
-        g_exit_code               = 0;
-
-        /* [E] Switch to child page directory and run */
-        __asm__ volatile("mov %0, %%cr3" :: "r"(child->cr3) : "memory");
-        exec_run(PROG_BASE, USER_STACK_TOP, child->phys_kstack + PAGE_SIZE);
-
-        /* [F] Child finished — SYS_EXIT did cli before longjmping here */
-        exec_ret_esp         = child->saved_exec_ret_esp;
-        unsigned int par_cr3 = child->parent_cr3;
-        int          ecode   = g_exit_code;
-
-        /* [G] Cleanup: switch to kernel page_dir, destroy child */
-        __asm__ volatile("mov %0, %%cr3" :: "r"(page_dir) : "memory");
-        process_destroy(child);
-
-        /* Update g_current before sti so IRQ0 sees correct state */
-        g_current     = parent;
-        parent->state = PROC_RUNNING;
-        tss_set_ring0_stack(parent->phys_kstack + PAGE_SIZE);
-        __asm__ volatile("sti");   /* re-enable interrupts */
-
-        /* [H] Restore VGA text mode, cwd, then switch to parent page_dir */
-        vga_check_and_restore_textmode();
-        fat16_set_cwd_cluster(saved_cwd);
-        __asm__ volatile("mov %0, %%cr3" :: "r"(par_cr3) : "memory");
-
-        r->eax = (unsigned int)ecode;
-        break;
-    }
-    case SYS_SLEEP: {
-        /* sleep(ms): block the current process for at least ms milliseconds.
-         * The PIT fires at PIT_HZ; each tick is 1000/PIT_HZ ms.
-         * The process spins on hlt (with interrupts enabled) until the timer
-         * ISR sets its state back to PROC_RUNNING. */
-        unsigned int ms = r->ebx;
-        unsigned int ticks = (ms * (unsigned int)PIT_HZ + 999u) / 1000u;
-        if (ticks == 0) ticks = 1;
-        g_current->wakeup_tick = g_ticks + ticks;
-        g_current->state = PROC_SLEEPING;
-        __asm__ volatile("sti");
-        while (g_current->state == PROC_SLEEPING)
-            __asm__ volatile("hlt");
-        r->eax = 0;
-        break;
-    }
-    default:
+/*
+ * Returns 0, or the saved ESP of another process to switch to.
+ * Every call is counted; the TSC delta around the handler is added to the
+ * syscall's cycle total.  Calls that block (getchar, sleep, waitpid,
+ * foreground exec) include the time spent blocked; exit and panic never
+ * return here and contribute only to the count.
+ */
+static unsigned int syscall_dispatch(struct registers *r)
+{
+    unsigned int nr = r->eax;
+    if (nr >= NR_SYSCALLS || !syscall_table[nr]) {
         r->eax = (unsigned int)-1;
-        break;
+        return 0;
     }
+    g_sc_stats[nr].count++;
+    unsigned long long t0 = rdtsc();
+    unsigned int esp = syscall_table[nr](r);
+    g_sc_stats[nr].cycles += rdtsc() - t0;
+    if (g_wb_due) {
+        __asm__ volatile("cli");   /* blocking handlers return with IF=1 */
+        wb_run();
+    }
+    return esp;
 }
 
 /* ============================================================
@@ -1528,17 +4248,38 @@ static const char *exception_name(unsigned int n)
 unsigned int isr_handler(struct registers *r)
 {
     if (r->int_no < 32) {
+        /* #NM: first FPU/SSE use since the last switch — lazy restore */
+        if (r->int_no == 7 && g_current) {
+            fpu_nm_trap();
+            return 0;
+        }
+
+        /* #PF on a copy-on-write page (present + write), a paged-out
+         * page, in an mmap() range or below the stack: give the process
+         * its copy / read the page back / map the file page / grow the
+         * stack and retry */
+        if (r->int_no == 14 && g_current && !g_user_io) {
+            unsigned int cr2;
+            __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+            g_reclaim_noio = !(r->err_code & 0x04);     /* from a syscall */
+            int ok = ((r->err_code & 0x03) == 0x03 && cow_fault(cr2) == 0) ||
+                     swap_fault(cr2) == 0 ||
+                     mmap_fault(cr2, r->err_code & 0x02) == 0 ||
+                     stack_fault(cr2) == 0;
+            g_reclaim_noio = 0;
+            if (ok) return 0;
+        }
+
         /* Page fault from user space: deliver segfault */
         if (r->int_no == 14 && (r->err_code & 0x04)) {
-            if (g_current && g_current->is_background) {
-                /* Background process: mark zombie, yield via hlt loop */
+            if (g_current && g_current->owner) {
+                /* Secondary thread: only the thread dies, with 139 */
                 print("\nSegmentation fault\n");
-                vga_check_and_restore_textmode();
-                fat16_set_cwd_cluster((unsigned short)g_current->saved_cwd_cluster);
-                g_current->exit_code = 139;
-                g_current->state = PROC_ZOMBIE;
-                __asm__ volatile("sti");
-                for (;;) __asm__ volatile("hlt");
+                return thread_exit(r, 139);
+            } else if (g_current && g_current->is_background) {
+                /* Background process: exit with 139 like SYS_EXIT would */
+                print("\nSegmentation fault\n");
+                return process_exit_bg(r, 139);
             } else if (exec_ret_esp != 0) {
                 /* Foreground process: longjmp back to SYS_EXEC handler */
                 print("\nSegmentation fault\n");
@@ -1576,10 +4317,18 @@ unsigned int isr_handler(struct registers *r)
             outb(0x20, 0x20);   /* EOI to master PIC */
             return 0;
         }
+        if (r->int_no == 36) {
+            /* IRQ4 — COM1: drain RX FIFO into ring, refill TX FIFO */
+            serial_irq();
+            outb(0x20, 0x20);   /* EOI to master PIC */
+            return 0;
+        }
         if (r->int_no == 32) {
             /* IRQ0 — PIT tick */
             int si;
             g_ticks++;
+            if (g_ticks % WB_INTERVAL == 0)
+                g_wb_due = 1;   /* flushed at the next safe point, see wb_run */
             /* Wake any processes whose sleep timer has expired */
             for (si = 0; si < PROC_MAX_PROCS; si++) {
                 if (g_procs[si].state == PROC_SLEEPING &&
@@ -1587,24 +4336,11 @@ unsigned int isr_handler(struct registers *r)
                     g_procs[si].state = PROC_RUNNING;
             }
             /* Preemptive context switch: find next runnable process */
-            if (g_current) {
-                struct process *next = pick_next_process();
-                if (next) {
-                    if (g_current->state != PROC_ZOMBIE) {
-                        /* Save current process's context */
-                        g_current->saved_esp = (unsigned int)r;
-                        if (g_current->state == PROC_RUNNING)
-                            g_current->state = PROC_READY;
-                    }
-                    /* Switch to next process (works for both normal and zombie) */
-                    next->state = PROC_RUNNING;
-                    g_current   = next;
-                    __asm__ volatile("mov %0, %%cr3" :: "r"(next->cr3) : "memory");
-                    tss_set_ring0_stack(next->phys_kstack + PAGE_SIZE);
-                    /* EOI before returning — must send before iret */
-                    outb(0x20, 0x20);
-                    return next->saved_esp;
-                }
+            unsigned int next_esp = schedule(r);
+            if (next_esp) {
+                /* EOI before returning — must send before iret */
+                outb(0x20, 0x20);
+                return next_esp;
             }
         }
         /* EOI */
@@ -1613,7 +4349,10 @@ unsigned int isr_handler(struct registers *r)
         outb(0x20, 0x20);       /* master EOI */
 
     } else if (r->int_no == 0x80) {
-        syscall_dispatch(r);
+        return syscall_dispatch(r);
+    } else if (r->int_no == 0x81) {
+        /* In-kernel reschedule (sleep_on): give the CPU away right now */
+        return schedule(r);
     }
     return 0;
 }
@@ -1639,41 +4378,49 @@ static unsigned int parse_uint(const unsigned char *s, int len)
 static void paging_init(void)
 {
     int i;
+    unsigned int eax = 1, ebx, ecx, edx, cr4;
+    __asm__ volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
 
-    /* Kernel page table: identity map 0–4MB, supervisor only */
+    /* Kernel page table: identity map 0–4MB, supervisor only.  Every
+     * address space shares it, so its entries are global: CR3 loads on
+     * context switch leave them in the TLB */
     for (i = 0; i < 1024; i++)
-        pt_kernel[i] = (unsigned int)(i << 12) | 0x03;   /* P + RW */
+        pt_kernel[i] = (unsigned int)(i << 12) | 0x03 | PTE_GLOBAL;   /* P + RW */
 
     /* VGA framebuffers 0xA0000–0xBFFFF need U=1 for ring-3 demo program */
     for (i = 0xA0; i <= 0xBF; i++)
-        pt_kernel[i] = (unsigned int)(i << 12) | 0x07;   /* P + RW + U */
+        pt_kernel[i] = (unsigned int)(i << 12) | 0x07 | PTE_GLOBAL;   /* P + RW + U */
 
     /* Enable PSE (4-MB pages) in CR4 */
-    __asm__ volatile (
-        "mov %%cr4, %%eax\n"
-        "or $0x10, %%eax\n"
-        "mov %%eax, %%cr4\n"
-        ::: "eax"
-    );
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile ("mov %0, %%cr4" :: "r"(cr4 | CR4_PSE));
 
     /* Kernel page directory */
-    for (i = 0; i < 1024; i++) page_dir[i] = 0;
+    memset(page_dir, 0, sizeof(page_dir));
 
     page_dir[0] = (unsigned int)pt_kernel | 0x07;   /* 4KB pages, 0–4MB */
 
     /* PDE[1]–PDE[511]: 4 MB large pages, supervisor-only identity map
-     * covering 4 MB–2 GB so kernel can write to any physical frame */
-    for (i = 1; i < 512; i++)
-        page_dir[i] = (unsigned int)(i << 22) | 0x83;   /* P+RW+PS, U=0 */
-
-    /* Load CR3 and enable paging + PSE in CR0 */
+     * covering 4 MB–2 GB so kernel can write to any physical frame, plus
+     * the direct map.  PDE[1] is not global: processes map their user PT
+     * there instead */
+    page_dir[1] = (unsigned int)(1 << 22) | 0x83;          /* P+RW+PS, U=0 */
+    pd_kernel_init(page_dir);
+
+    /* Load CR3 and enable paging in CR0; WP makes the kernel's own writes
+     * to read-only user pages fault too, so copy-on-write also covers
+     * syscalls writing into user buffers */
     __asm__ volatile (
         "mov %0, %%cr3\n"
         "mov %%cr0, %%eax\n"
-        "or $0x80000000, %%eax\n"
+        "or $0x80010000, %%eax\n"
         "mov %%eax, %%cr0\n"
         : : "r"(page_dir) : "eax"
     );
+
+    /* Honour the global bits; must follow CR0.PG */
+    if ((edx >> 13) & 1)
+        __asm__ volatile ("mov %0, %%cr4" :: "r"(cr4 | CR4_PSE | CR4_PGE));
 }
 
 /* ============================================================
@@ -1688,6 +4435,9 @@ void kernel_main(void)
     paging_init();
     serial_print("[kernel] paging ready\n");
 
+    fpu_init();
+    serial_print("[kernel] FPU ready\n");
+
     gdt_init();
     serial_print("[kernel] GDT ready\n");
 
@@ -1733,15 +4483,20 @@ void kernel_main(void)
     serial_print("[kernel] ready\n");
 
     pit_init();
+    serial_enable_irq();
     serial_print("[kernel] PIT ready (100 Hz)\n");
 
     pmm_init();
     serial_print("[kernel] PMM ready\n");
 
+    swap_init();
+    serial_print(swap_ready ? "[swap] 512 KB in " SWAP_FILE "\n" : "[swap] off\n");
+
     /* Create shell process */
     struct process *shell = process_create("sh", "");
     if (!shell) {
         vga_print("FATAL: /bin/sh not found\n", COLOR_ERR);
+        serial_flush();
         for (;;) __asm__ volatile("hlt");
     }
     g_current    = shell;
@@ -1754,5 +4509,6 @@ void kernel_main(void)
 
     /* Shell called exit() — unrecoverable */
     print("Shell exited. System halted.\n");
+    serial_flush();
     for (;;) __asm__ volatile("hlt");
 }
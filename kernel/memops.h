@@ -0,0 +1,68 @@
+#ifndef MEMOPS_H
+#define MEMOPS_H
+
+/*
+ * memcpy / memset / memmove — shared by the kernel and user programs
+ * (bin/os.h includes this file).
+ *
+ * The bulk moves a dword per iteration with rep movsl / rep stosl and the
+ * 0-3 byte tail goes with rep movsb / rep stosb.  Only general-purpose
+ * registers are used, so the kernel can call these without owning the FPU
+ * (see "Lazy FPU" in kernel.c); user programs get SSE2 variants on top in
+ * os.h.  All of them assume EFLAGS.DF = 0, which the ABI guarantees and
+ * the kernel entry paths re-establish with cld.
+ */
+
+static inline void *memcpy(void *dst, const void *src, unsigned int n)
+{
+    unsigned int d0, d1, d2;
+    __asm__ volatile (
+        "rep movsl\n"
+        "movl %4, %%ecx\n"
+        "rep movsb"
+        : "=&c"(d0), "=&D"(d1), "=&S"(d2)
+        : "0"(n >> 2), "g"(n & 3), "1"(dst), "2"(src)
+        : "memory"
+    );
+    return dst;
+}
+
+static inline void *memset(void *s, int c, unsigned int n)
+{
+    unsigned int d0, d1;
+    __asm__ volatile (
+        "rep stosl\n"
+        "movl %3, %%ecx\n"
+        "rep stosb"
+        : "=&c"(d0), "=&D"(d1)
+        : "a"((unsigned char)c * 0x01010101u), "g"(n & 3), "0"(n >> 2), "1"(s)
+        : "memory"
+    );
+    return s;
+}
+
+/* Overlap-safe copy: forward unless dst lies inside [src, src+n). */
+static inline void *memmove(void *dst, const void *src, unsigned int n)
+{
+    if ((unsigned int)dst - (unsigned int)src >= n)
+        return memcpy(dst, src, n);
+
+    /* Backwards: the odd tail bytes first, then whole dwords, DF=1 */
+    unsigned int d0, d1, d2;
+    __asm__ volatile (
+        "std\n"
+        "rep movsb\n"
+        "subl $3, %%edi\n"
+        "subl $3, %%esi\n"
+        "movl %4, %%ecx\n"
+        "rep movsl\n"
+        "cld"
+        : "=&c"(d0), "=&D"(d1), "=&S"(d2)
+        : "0"(n & 3), "g"(n >> 2),
+          "1"((char *)dst + n - 1), "2"((const char *)src + n - 1)
+        : "memory"
+    );
+    return dst;
+}
+
+#endif /* MEMOPS_H */
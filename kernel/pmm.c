@@ -8,6 +8,11 @@
  *
  * Bit = 0 → frame is free; bit = 1 → frame is used.
  * Frame index 0 corresponds to physical address PMM_BASE (0x100000).
+ *
+ * A frame mapped by several owners (shared memory) carries a reference
+ * count: pmm_refs[] holds the owners beyond the first, so the common
+ * single-owner frame costs nothing and pmm_free() only clears the bit
+ * when the last owner lets go.
  */
 
 #include "pmm.h"
@@ -18,7 +23,12 @@
 #define PMM_TOTAL_FRAMES ((PMM_END - PMM_BASE) / PMM_FRAME_SIZE)  /* 32512 */
 #define PMM_BITMAP_WORDS ((PMM_TOTAL_FRAMES + 31) / 32)           /* 1016  */
 
-static unsigned int pmm_bitmap[PMM_BITMAP_WORDS];
+/* Frames 4–8 MB: virtual 4–8 MB is user space under a process CR3 */
+#define PMM_USER_WIN_FIRST ((0x400000u - PMM_BASE) / PMM_FRAME_SIZE)  /* 768  */
+#define PMM_USER_WIN_END   ((0x800000u - PMM_BASE) / PMM_FRAME_SIZE)  /* 1792 */
+
+static unsigned int  pmm_bitmap[PMM_BITMAP_WORDS];
+static unsigned char pmm_refs[PMM_TOTAL_FRAMES];   /* extra owners per frame */
 
 /* Mark a frame as used */
 static void pmm_set(unsigned int frame)
@@ -44,6 +54,8 @@ void pmm_init(void)
     /* All frames start as free (bitmap zeroed by BSS initialisation) */
     for (i = 0; i < PMM_BITMAP_WORDS; i++)
         pmm_bitmap[i] = 0;
+    for (i = 0; i < PMM_TOTAL_FRAMES; i++)
+        pmm_refs[i] = 0;
 }
 
 /*
@@ -70,6 +82,30 @@ unsigned int pmm_alloc(void)
     return 0;
 }
 
+/*
+ * Allocate one frame for a kernel object (page table, kernel stack, open
+ * file, ...).  The kernel reaches these through the identity map, which
+ * every process page directory keeps except for 4–8 MB: PDE[1] there
+ * points at the user page table.  Frames in that window are skipped.
+ * Returns the physical address of the frame, or 0 on failure.
+ */
+unsigned int pmm_alloc_kernel(void)
+{
+    unsigned int frame;
+    for (frame = 0; frame < PMM_TOTAL_FRAMES; frame++) {
+        if (frame == PMM_USER_WIN_FIRST) frame = PMM_USER_WIN_END;
+        if (frame % 32 == 0 && pmm_bitmap[frame / 32] == 0xFFFFFFFFu) {
+            frame += 31;   /* whole word used */
+            continue;
+        }
+        if (!pmm_test(frame)) {
+            pmm_set(frame);
+            return PMM_BASE + frame * PMM_FRAME_SIZE;
+        }
+    }
+    return 0;
+}
+
 /*
  * Allocate n contiguous physical frames.
  * Returns the physical address of the first frame, or 0 on failure.
@@ -116,12 +152,27 @@ unsigned int pmm_count_used(void)
 }
 
 /*
- * Free a single physical frame previously returned by pmm_alloc /
- * pmm_alloc_contiguous.
+ * Drop one reference to a physical frame previously returned by pmm_alloc /
+ * pmm_alloc_contiguous; the frame is free once the last one is gone.
  */
 void pmm_free(unsigned int pa)
 {
     if (pa < PMM_BASE || pa >= PMM_END) return;
     unsigned int frame = (pa - PMM_BASE) / PMM_FRAME_SIZE;
+    if (pmm_refs[frame]) { pmm_refs[frame]--; return; }
     pmm_clear(frame);
 }
+
+/* Add an owner to an allocated frame; each owner calls pmm_free() once. */
+void pmm_ref(unsigned int pa)
+{
+    if (pa < PMM_BASE || pa >= PMM_END) return;
+    pmm_refs[(pa - PMM_BASE) / PMM_FRAME_SIZE]++;
+}
+
+/* Non-zero while more than one owner holds the frame. */
+int pmm_shared(unsigned int pa)
+{
+    if (pa < PMM_BASE || pa >= PMM_END) return 0;
+    return pmm_refs[(pa - PMM_BASE) / PMM_FRAME_SIZE] != 0;
+}
@@ -3,8 +3,11 @@
 
 void         pmm_init(void);
 unsigned int pmm_alloc(void);
+unsigned int pmm_alloc_kernel(void);  /* frame outside the user window */
 unsigned int pmm_alloc_contiguous(int n);
-void         pmm_free(unsigned int pa);
+void         pmm_free(unsigned int pa);  /* drops one reference          */
+void         pmm_ref(unsigned int pa);   /* one more owner (shared frame) */
+int          pmm_shared(unsigned int pa); /* more than one owner?         */
 unsigned int pmm_total(void);        /* total managed frames          */
 unsigned int pmm_count_used(void);   /* number of allocated frames    */
 
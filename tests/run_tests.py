@@ -118,6 +118,17 @@ def test_xxd(child: pexpect.spawn):
         return False, 'no hex dump output'
 
 
+def test_xxd_seek(child: pexpect.spawn):
+    """xxd -s 16 /bin/hello starts the dump at offset 0x10."""
+    child.sendline('xxd -s 16 /bin/hello')
+    try:
+        child.expect('00000010:', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'dump starts at offset 00000010:'
+    except pexpect.TIMEOUT:
+        return False, 'no dump at offset 00000010:'
+
+
 def test_xxd_missing_file(child: pexpect.spawn):
     """xxd on a non-existent file prints an error."""
     child.sendline('xxd NOSUCHFILE.TXT')
@@ -129,6 +140,28 @@ def test_xxd_missing_file(child: pexpect.spawn):
         return False, 'no error message for missing file'
 
 
+def test_pipeline(child: pexpect.spawn):
+    """hello | xxd: xxd dumps hello's output, read from a pipe on its stdin."""
+    child.sendline('hello | xxd')
+    try:
+        child.expect('00000000: 4865 6c6c 6f2c 2077 6f72 6c64 210a', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'xxd dumped the hello output from the pipe'
+    except pexpect.TIMEOUT:
+        return False, 'no dump of hello output'
+
+
+def test_serial_burst(child: pexpect.spawn):
+    """A long command line sent in one burst arrives intact (IRQ4 RX ring)."""
+    child.sendline('xxd /bin/../bin/../bin/../bin/../bin/../bin/hello')
+    try:
+        child.expect('00000000:', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'long line received without dropped characters'
+    except pexpect.TIMEOUT:
+        return False, 'command line corrupted (characters dropped?)'
+
+
 def test_vi_quit(child: pexpect.spawn):
     """vi opens the editor; :q! returns to the shell."""
     child.sendline('vi test.txt')
@@ -256,6 +289,8 @@ def test_free(child: pexpect.spawn):
         return False, 'Phys: line missing'
     if 'Virt:' not in out:
         return False, 'Virt: line missing'
+    if 'Swap:' not in out:
+        return False, 'Swap: line missing'
     # PMM manages 0x100000–0x7FFFFFF = 32512 frames × 4 kB = 130048 kB
     if '130048' not in out:
         return False, 'expected phys total 130048 kB not found'
@@ -265,7 +300,24 @@ def test_free(child: pexpect.spawn):
     if '(2 procs)' not in out:
         return False, '(2 procs) not found — expected shell + free'
 
-    return True, 'Phys/Virt rows present, total=130048 kB, kB units, (2 procs)'
+    return True, 'Phys/Virt/Swap rows present, total=130048 kB, kB units, (2 procs)'
+
+
+def test_ps(child: pexpect.spawn):
+    """ps lists the shell (waiting) and itself with their resident size."""
+    child.sendline('ps')
+    try:
+        child.expect(r'PID +PPID S THR +RSS +SWAP +HEAP +RLIM +HLIM NAME', timeout=TIMEOUT_CMD)
+        child.expect(r'\d+ +0 W +0 +\d+ +0 +\d+ +- +- sh', timeout=TIMEOUT_CMD)
+        child.expect(r'\d+ +\d+ R +0 +(\d+) +0 +0 +- +- ps', timeout=TIMEOUT_CMD)
+        rss = int(child.match.group(1))
+        wait_prompt(child)
+    except pexpect.TIMEOUT:
+        return False, 'header, sh row or ps row missing'
+    # binary (256 kB) + args page + at least one stack page
+    if rss < 264:
+        return False, f'ps resident size {rss} kB, expected >= 264'
+    return True, f'sh (W) and ps (R, {rss} kB resident) rows'
 
 
 def test_malloc(child: pexpect.spawn):
@@ -325,6 +377,302 @@ def test_background(child: pexpect.spawn):
         return False, '"bg: OK" did not appear from background process'
 
 
+def test_waitpid(child: pexpect.spawn):
+    """t_wait: reap 3 background children, check exit codes and freed frames."""
+    child.sendline('t_wait')
+    try:
+        child.expect('wait: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'exit codes collected, no frames leaked'
+    except pexpect.TIMEOUT:
+        return False, 't_wait did not print "wait: OK"'
+
+
+def test_wait_builtin(child: pexpect.spawn):
+    """t_bg & followed by the wait builtin: prompt returns only after bg: OK."""
+    child.sendline('t_bg &')
+    if not wait_prompt(child):
+        return False, 'shell did not return prompt after t_bg &'
+    child.sendline('wait')
+    try:
+        child.expect('bg: OK', timeout=5)
+        wait_prompt(child)
+        return True, 'wait blocked until the background job exited'
+    except pexpect.TIMEOUT:
+        return False, '"bg: OK" did not appear before the prompt'
+
+
+def test_ulimit(child: pexpect.spawn):
+    """ulimit sets and shows the shell's heap limit, and removes it again."""
+    child.sendline('ulimit -d 128')
+    if not wait_prompt(child):
+        return False, 'shell did not return prompt after ulimit -d'
+    child.sendline('ulimit')
+    try:
+        child.expect('heap: 128 kB', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+    except pexpect.TIMEOUT:
+        return False, '"heap: 128 kB" not shown'
+    child.sendline('ulimit -d 0')
+    wait_prompt(child)
+    child.sendline('ulimit')
+    try:
+        child.expect('heap: unlimited', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'heap limit set, shown and removed'
+    except pexpect.TIMEOUT:
+        return False, 'heap limit not removed'
+
+
+def test_scbench(child: pexpect.spawn):
+    """scbench: null syscall via int 0x80 and SYSENTER both return to user mode."""
+    child.sendline('scbench')
+    try:
+        child.expect(r'int 0x80: +\d+ cycles/call', timeout=TIMEOUT_CMD)
+        child.expect(r'sysenter: +\d+ cycles/call', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'both syscall paths completed'
+    except pexpect.TIMEOUT:
+        return False, 'scbench did not report both paths'
+
+
+def test_membench(child: pexpect.spawn):
+    """membench: byte, rep and SSE2 memcpy/memset all produce the right bytes."""
+    child.sendline('membench')
+    try:
+        idx = child.expect([r'membench: OK', r'membench: FAIL [^\r\n]*'], timeout=TIMEOUT_CMD)
+        out = child.before + child.after
+        wait_prompt(child)
+        if idx != 0:
+            return False, child.after.strip()
+        if 'memcpy rep:' not in out or 'memset rep:' not in out:
+            return False, 'missing rep rows'
+        return True, 'all copy/fill paths verified'
+    except pexpect.TIMEOUT:
+        return False, 'membench did not finish'
+
+
+def test_msgbench(child: pexpect.spawn):
+    """msgbench: send/receive/reply ping-pong with a server child, plus error cases."""
+    child.sendline('msgbench')
+    try:
+        idx = child.expect([r'msg  round trip: +(\d+) cycles', r'msgbench: FAIL [^\r\n]*'],
+                           timeout=TIMEOUT_CMD)
+        if idx != 0:
+            why = child.after.strip()
+            wait_prompt(child)
+            return False, why
+        cycles = int(child.match.group(1))
+        idx = child.expect([r'msgbench: OK', r'msgbench: FAIL [^\r\n]*'], timeout=TIMEOUT_CMD)
+        out = child.before + child.after
+        wait_prompt(child)
+        if idx != 0:
+            return False, child.after.strip()
+        if 'pipe round trip:' not in out:
+            return False, 'missing pipe round-trip row'
+        return True, f'{cycles} cycles per message round trip'
+    except pexpect.TIMEOUT:
+        return False, 'msgbench did not finish'
+
+
+def test_sysstat(child: pexpect.spawn):
+    """sysstat lists per-syscall counts; getpid calls from scbench are included."""
+    child.sendline('sysstat')
+    try:
+        child.expect(r'getpid +\d+ +\d+', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'getpid row present with count and avg cycles'
+    except pexpect.TIMEOUT:
+        return False, 'no getpid row in sysstat output'
+
+
+def test_fpu(child: pexpect.spawn):
+    """t_fpu: two processes keep XMM0/ST(0) values across 200 yields each."""
+    child.sendline('t_fpu')
+    try:
+        child.expect('fpu: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'SSE and x87 state preserved across context switches'
+    except pexpect.TIMEOUT:
+        return False, 't_fpu did not print "fpu: OK"'
+
+
+def test_file_stream(child: pexpect.spawn):
+    """t_file: write and read back a 40000-byte file (past the old 16 KB cap)."""
+    child.sendline('t_file')
+    try:
+        child.expect('file: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, '40000-byte file written and read back intact'
+    except pexpect.TIMEOUT:
+        return False, 't_file did not print "file: OK"'
+
+
+def test_seek(child: pexpect.spawn):
+    """t_seek: lseek, O_RDWR, O_APPEND, O_CREAT/O_TRUNC and a zero-filled gap."""
+    child.sendline('t_seek')
+    try:
+        child.expect('seek: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'in-place edit, append, gap and truncate all behave'
+    except pexpect.TIMEOUT:
+        return False, 't_seek did not print "seek: OK"'
+
+
+def test_writeback(child: pexpect.spawn):
+    """t_wb: dirty pages left by close() are written back by the timer flusher."""
+    child.sendline('t_wb')
+    try:
+        child.expect('wb: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'closed file flushed in the background, size and data intact'
+    except pexpect.TIMEOUT:
+        return False, 't_wb did not print "wb: OK"'
+
+
+def test_mmap(child: pexpect.spawn):
+    """t_mmap: MAP_SHARED writes reach read(), MAP_PRIVATE writes stay private."""
+    child.sendline('t_mmap')
+    try:
+        child.expect('mmap: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'shared and private file mappings behave'
+    except pexpect.TIMEOUT:
+        return False, 't_mmap did not print "mmap: OK"'
+
+
+def test_pipe(child: pexpect.spawn):
+    """t_pipe: 20000 bytes through a pipe from a child that inherited it as stdout."""
+    child.sendline('t_pipe')
+    try:
+        child.expect('pipe: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'data, EOF and error cases correct, no frames leaked'
+    except pexpect.TIMEOUT:
+        return False, 't_pipe did not print "pipe: OK"'
+
+
+def test_shm(child: pexpect.spawn):
+    """t_shm: a child attaches the parent's shared memory segment by key."""
+    child.sendline('t_shm')
+    try:
+        child.expect('shm: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'segment shared between processes, freed on last detach'
+    except pexpect.TIMEOUT:
+        return False, 't_shm did not print "shm: OK"'
+
+
+def test_fork(child: pexpect.spawn):
+    """t_fork: fork() children see the parent's memory as of fork, copy-on-write."""
+    child.sendline('t_fork')
+    try:
+        child.expect('fork: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'writes stay private on both sides, shm shared, no frames leaked'
+    except pexpect.TIMEOUT:
+        return False, 't_fork did not print "fork: OK"'
+
+
+def test_thread(child: pexpect.spawn):
+    """t_thread: threads share memory, a futex mutex keeps the counter exact."""
+    child.sendline('t_thread')
+    try:
+        child.expect('thread: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'mutex counter exact, joins and guard page fault ok, no frames leaked'
+    except pexpect.TIMEOUT:
+        return False, 't_thread did not print "thread: OK"'
+
+
+def test_stack(child: pexpect.spawn):
+    """t_stack: the stack grows on demand and stops at the guard page."""
+    child.sendline('t_stack')
+    try:
+        child.expect('stack: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, '16 KB recursion intact, args intact, overflow -> 139, no frames leaked'
+    except pexpect.TIMEOUT:
+        return False, 't_stack did not print "stack: OK"'
+
+
+def test_swap(child: pexpect.spawn):
+    """t_swap: pages go to the swap file and come back intact."""
+    child.sendline('t_swap')
+    try:
+        child.expect('swap: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'heap and stack paged out and back, across fork and exit, no slots leaked'
+    except pexpect.TIMEOUT:
+        return False, 't_swap did not print "swap: OK"'
+
+
+def test_limit(child: pexpect.spawn):
+    """t_limit: heap and RSS limits, their inheritance, procinfo()."""
+    child.sendline('t_limit')
+    try:
+        child.expect('limit: OK', timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        return True, 'heap limit stops sbrk, is inherited; RSS limit pages out own pages'
+    except pexpect.TIMEOUT:
+        return False, 't_limit did not print "limit: OK"'
+
+
+def test_ctxbench(child: pexpect.spawn):
+    """ctxbench: yield() ping-pong with a process and with a thread."""
+    child.sendline('ctxbench')
+    try:
+        idx = child.expect([r'process switch: +(\d+) cycles', r'ctxbench: FAIL [^\r\n]*'],
+                           timeout=TIMEOUT_CMD)
+        if idx != 0:
+            why = child.after.strip()
+            wait_prompt(child)
+            return False, why
+        proc = int(child.match.group(1))
+        idx = child.expect([r'thread switch: +(\d+) cycles', r'ctxbench: FAIL [^\r\n]*'],
+                           timeout=TIMEOUT_CMD)
+        if idx != 0:
+            why = child.after.strip()
+            wait_prompt(child)
+            return False, why
+        thread = int(child.match.group(1))
+        idx = child.expect([r'ctxbench: OK', r'ctxbench: FAIL [^\r\n]*'], timeout=TIMEOUT_CMD)
+        wait_prompt(child)
+        if idx != 0:
+            return False, child.after.strip()
+        return True, f'{proc} cycles per process switch, {thread} per thread switch'
+    except pexpect.TIMEOUT:
+        return False, 'ctxbench did not finish'
+
+
+def test_readahead(child: pexpect.spawn):
+    """After t_file streams /bin/vi from disk, sysstat reports readahead hits."""
+    child.sendline('sysstat')
+    try:
+        child.expect(r'readahead: +(\d+) prefetched, +(\d+) hits', timeout=TIMEOUT_CMD)
+        hits = int(child.match.group(2))
+        wait_prompt(child)
+        if hits == 0:
+            return False, 'readahead hits = 0'
+        return True, f'{hits} readahead hits'
+    except pexpect.TIMEOUT:
+        return False, 'no readahead line in sysstat output'
+
+
+def test_direct_read(child: pexpect.spawn):
+    """After t_file reads /bin/vi in one call, sysstat reports direct page reads."""
+    child.sendline('sysstat')
+    try:
+        child.expect(r'direct reads: +(\d+) pages', timeout=TIMEOUT_CMD)
+        pages = int(child.match.group(1))
+        wait_prompt(child)
+        if pages == 0:
+            return False, 'direct reads = 0'
+        return True, f'{pages} pages read straight into user buffers'
+    except pexpect.TIMEOUT:
+        return False, 'no direct reads line in sysstat output'
+
+
 def test_exec_stress(child: pexpect.spawn):
     """t_exec: spawn hello 300 times sequentially; verify all succeed."""
     child.sendline('t_exec')
@@ -432,16 +780,42 @@ TESTS = [
     ('hello',             test_hello),
     ('ls',                test_ls),
     ('xxd',               test_xxd),
+    ('xxd_seek',          test_xxd_seek),
     ('xxd_missing_file',  test_xxd_missing_file),
+    ('pipeline',          test_pipeline),
+    ('serial_burst',      test_serial_burst),
     ('vi_quit',           test_vi_quit),
     ('t_segflt',          test_segfault),
     ('fs_operations',     test_fs_operations),
     ('paths',             test_paths),
     ('free',              test_free),
+    ('ps',                test_ps),
     ('t_mall1',           test_malloc),
     ('t_mall2',           test_malloc_oob),
     ('t_sleep',           test_sleep),
     ('background',        test_background),
+    ('t_wait',            test_waitpid),
+    ('wait',              test_wait_builtin),
+    ('ulimit',            test_ulimit),
+    ('scbench',           test_scbench),
+    ('membench',          test_membench),
+    ('msgbench',          test_msgbench),
+    ('sysstat',           test_sysstat),   # after scbench (needs getpid calls)
+    ('t_fpu',             test_fpu),
+    ('t_file',            test_file_stream),
+    ('t_seek',            test_seek),
+    ('t_wb',              test_writeback),
+    ('t_mmap',            test_mmap),
+    ('t_pipe',            test_pipe),
+    ('t_shm',             test_shm),
+    ('t_fork',            test_fork),
+    ('t_thread',          test_thread),
+    ('t_stack',           test_stack),
+    ('t_swap',            test_swap),
+    ('t_limit',           test_limit),
+    ('ctxbench',          test_ctxbench),
+    ('readahead',         test_readahead),  # after t_file (needs sequential reads)
+    ('direct_read',       test_direct_read),  # after t_file (needs a whole-page read)
     ('t_exec',            test_exec_stress),
     ('t_panic',           test_panic),   # must be last — halts the system
 ]